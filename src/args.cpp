@@ -8,4 +8,55 @@
 void Arguments::print(std::ostream &OS) const {
   OS << "FSB/SDRAM/PCI: " << Fsb << std::endl;
   OS << "PLL: " << PLL << std::endl;
+  if (RampDwellMillis)
+    OS << "Ramp dwell: " << *RampDwellMillis << "ms" << std::endl;
+  if (ScanSMBus)
+    OS << "Scan SMBus" << std::endl;
+  if (ShowSPD)
+    OS << "Show SPD" << std::endl;
+  if (MonitorIntervalMillis)
+    OS << "Monitor interval: " << *MonitorIntervalMillis << "ms" << std::endl;
+  if (ShowDRAM)
+    OS << "Show DRAM" << std::endl;
+  if (!ChipsetOpt.empty())
+    OS << "Chipset opt: " << ChipsetOpt << " " << ChipsetOptName << std::endl;
+  if (!PCITune.empty())
+    OS << "PCI tune: " << PCITune << std::endl;
+  if (!MTRR.empty()) {
+    OS << "MTRR: " << MTRR;
+    if (MTRR == "remove")
+      OS << " " << MTRRIdx;
+    OS << std::endl;
+  }
+  if (!MSRFile.empty())
+    OS << "MSR file: " << MSRFile << std::endl;
+  if (!Governor.empty())
+    OS << "Governor: " << Governor << std::endl;
+  if (!Script.empty())
+    OS << "Script: " << Script << std::endl;
+  if (ListPCI)
+    OS << "List PCI" << std::endl;
+  if (Settle)
+    OS << "Measure settle times" << std::endl;
+  if (StressCPUSeconds)
+    OS << "Stress CPU: " << *StressCPUSeconds << "s" << std::endl;
+  if (!Snapshot.empty())
+    OS << "Snapshot: " << Snapshot << " " << SnapshotFile << " "
+       << SnapshotFile2 << std::endl;
+  if (IOBudget)
+    OS << "I/O budget check" << std::endl;
+  if (MNPLLCheck)
+    OS << "M/N solver check" << std::endl;
+  if (SimPLL)
+    OS << "Simulated PLL" << std::endl;
+  if (!RecordFile.empty())
+    OS << "Record port I/O: " << RecordFile << std::endl;
+  if (!ReplayFile.empty())
+    OS << "Replay port I/O: " << ReplayFile << std::endl;
+  if (ShowTiming)
+    OS << "Timing" << std::endl;
+  if (NoCache)
+    OS << "No discovery cache" << std::endl;
+  if (IgnoreSPD)
+    OS << "Ignoring SPD SDRAM limits!" << std::endl;
 }
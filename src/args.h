@@ -9,6 +9,7 @@
 #include "freqentry.h"
 #include <iomanip>
 #include <iostream>
+#include <optional>
 #include <string>
 
 struct Arguments {
@@ -16,6 +17,68 @@ struct Arguments {
   FreqEntry Fsb;
   /// The PLL Name.
   std::string PLL;
+  /// If set, ramp to the target FSB through the intermediate table entries,
+  /// waiting this many milliseconds after each step.
+  std::optional<unsigned> RampDwellMillis;
+  /// List the devices found on the SMBus.
+  bool ScanSMBus = false;
+  /// Print the DIMM SPD information.
+  bool ShowSPD = false;
+  /// Don't limit the SDRAM frequency to what the DIMMs are rated for.
+  bool IgnoreSPD = false;
+  /// If set, print the hardware monitor sensors every this many milliseconds.
+  std::optional<unsigned> MonitorIntervalMillis;
+  /// Print the DRAM timings of the host bridge.
+  bool ShowDRAM = false;
+  /// The -chipset-opt command: list, show, enable, disable or profile.
+  std::string ChipsetOpt;
+  /// The feature name for the enable/disable commands.
+  std::string ChipsetOptName;
+  /// The -pci-tune command: dry-run, apply or restore.
+  std::string PCITune;
+  /// The -mtrr command: list, wc or remove.
+  std::string MTRR;
+  /// The MTRR index for the remove command.
+  unsigned MTRRIdx = 0;
+  /// If set, access the MSRs through this file instead of the default.
+  std::string MSRFile;
+  /// Don't use or update the discovery cache.
+  bool NoCache = false;
+  /// Print the time and I/O spent in each phase.
+  bool ShowTiming = false;
+  /// If set, log all port I/O to this file...
+  std::string RecordFile;
+  /// ...or serve it from this log instead of the hardware.
+  std::string ReplayFile;
+  /// If set, run the FSB governor with this "name=value,..." configuration.
+  std::string Governor;
+  /// If set, run the commands in this file.
+  std::string Script;
+  /// List the PCI functions with their names.
+  bool ListPCI = false;
+  /// Measure the settle time of each PLL switch on the way to -fsb and back.
+  bool Settle = false;
+  /// If set, run the CPU stress kernels for this many seconds, after setting
+  /// the -fsb frequency if given.
+  std::optional<unsigned> StressCPUSeconds;
+  /// The -snapshot command: save, restore or diff.
+  std::string Snapshot;
+  /// The snapshot file, and the second one for diff.
+  std::string SnapshotFile;
+  std::string SnapshotFile2;
+  /// Check the I/O of the PLL commands against their budgets.
+  bool IOBudget = false;
+  /// Check the M/N divider solver against its reference model.
+  bool MNPLLCheck = false;
+  /// Talk to a simulated PLL instead of the real SMBus.
+  bool SimPLL = false;
+  /// \Returns false if we are running a mode that does not touch the PLL.
+  bool needsPLL() const {
+    return !ScanSMBus && !ShowSPD && !MonitorIntervalMillis && !ShowDRAM &&
+           ChipsetOpt.empty() && PCITune.empty() && MTRR.empty() &&
+           Script.empty() && Snapshot.empty() && !IOBudget && !MNPLLCheck &&
+           !ListPCI && !(StressCPUSeconds && Fsb.bad());
+  }
   void print(std::ostream &OS) const;
   friend std::ostream &operator<<(std::ostream &OS, const Arguments &Args) {
     Args.print(OS);
@@ -0,0 +1,74 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Little-endian helpers for our small binary files (the discovery cache and
+// the hardware snapshots).
+//
+
+#ifndef __SRC_BINFILE_H__
+#define __SRC_BINFILE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BinWriter {
+  std::vector<uint8_t> &Bytes;
+
+public:
+  BinWriter(std::vector<uint8_t> &Bytes) : Bytes(Bytes) {}
+  void put(uint32_t Val, unsigned Size) {
+    for (unsigned Idx = 0; Idx != Size; ++Idx)
+      Bytes.push_back((Val >> (Idx * 8)) & 0xff);
+  }
+  void putStr(const std::string &Str, unsigned Size) {
+    for (unsigned Idx = 0; Idx != Size; ++Idx)
+      Bytes.push_back(Idx < Str.size() ? Str[Idx] : 0);
+  }
+  /// Overwrites the \p Size bytes at \p Pos, for fields like checksums that
+  /// are only known at the end.
+  void patch(size_t Pos, uint32_t Val, unsigned Size) {
+    for (unsigned Idx = 0; Idx != Size; ++Idx)
+      Bytes[Pos + Idx] = (Val >> (Idx * 8)) & 0xff;
+  }
+};
+
+/// The caller checks the size, reading past the end is not caught.
+class BinReader {
+  const std::vector<uint8_t> &Bytes;
+  size_t Pos;
+
+public:
+  BinReader(const std::vector<uint8_t> &Bytes, size_t Pos = 0)
+      : Bytes(Bytes), Pos(Pos) {}
+  uint32_t get(unsigned Size) {
+    uint32_t Val = 0;
+    for (unsigned Idx = 0; Idx != Size; ++Idx)
+      Val |= (uint32_t)Bytes[Pos++] << (Idx * 8);
+    return Val;
+  }
+  std::string getStr(unsigned Size) {
+    std::string Str;
+    for (unsigned Idx = 0; Idx != Size; ++Idx, ++Pos)
+      if (Bytes[Pos] != 0 && Str.size() == Idx)
+        Str += (char)Bytes[Pos];
+    return Str;
+  }
+  size_t getPos() const { return Pos; }
+};
+
+/// FNV-1a from \p Begin to the end, good enough for catching truncated or
+/// corrupted files.
+inline uint32_t getBinChecksum(const std::vector<uint8_t> &Bytes,
+                               size_t Begin) {
+  uint32_t Hash = 2166136261u;
+  for (size_t Idx = Begin, E = Bytes.size(); Idx != E; ++Idx) {
+    Hash ^= Bytes[Idx];
+    Hash *= 16777619u;
+  }
+  return Hash;
+}
+
+#endif // __SRC_BINFILE_H__
@@ -0,0 +1,119 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "cache.h"
+#include "binfile.h"
+#include "utils.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+HWFingerprint HWFingerprint::read(const BDF &Addr) {
+  HWFingerprint FP;
+  FP.ID = PCI::readDword(Addr, PCI::VendorIdReg);
+  FP.ClassRev = PCI::readDword(Addr, ClassRevReg);
+  FP.Subsystem = PCI::readDword(Addr, SubsystemReg);
+  return FP;
+}
+
+// The file layout, all little-endian:
+//   u32 Magic, u16 Version, u16 PayloadLen, u32 Checksum, Payload
+// with the payload being:
+//   u32 ID, u32 ClassRev, u32 Subsystem, char HostBridge[MaxNameLen],
+//   u16 SMBusAddr, char PLL[MaxNameLen], u8 PLLAddr, u8 BlockLen,
+//   u8 PLLBlock[MaxBlockLen]
+static constexpr const unsigned HeaderLen = 12;
+static constexpr const unsigned PayloadLen =
+    3 * 4 + DiscoveryCache::MaxNameLen + 2 + DiscoveryCache::MaxNameLen + 1 +
+    1 + DiscoveryCache::MaxBlockLen;
+
+std::optional<DiscoveryCache>
+DiscoveryCache::load(const std::string &Path, const HWFingerprint &Expected) {
+  std::ifstream File(Path, std::ios::binary);
+  if (!File)
+    return std::nullopt;
+  std::vector<uint8_t> Bytes((std::istreambuf_iterator<char>(File)),
+                             std::istreambuf_iterator<char>());
+  if (Bytes.size() != HeaderLen + PayloadLen) {
+    if (isDebug())
+      std::cout << Path << ": bad size" << std::endl;
+    return std::nullopt;
+  }
+  BinReader R(Bytes);
+  if (R.get(4) != Magic || R.get(2) != Version || R.get(2) != PayloadLen ||
+      R.get(4) != getBinChecksum(Bytes, HeaderLen)) {
+    if (isDebug())
+      std::cout << Path << ": bad header or checksum" << std::endl;
+    return std::nullopt;
+  }
+  DiscoveryCache Cache;
+  Cache.Fingerprint.ID = R.get(4);
+  Cache.Fingerprint.ClassRev = R.get(4);
+  Cache.Fingerprint.Subsystem = R.get(4);
+  if (Cache.Fingerprint != Expected) {
+    if (isDebug())
+      std::cout << Path << ": fingerprint mismatch" << std::endl;
+    return std::nullopt;
+  }
+  Cache.HostBridge = R.getStr(MaxNameLen);
+  Cache.SMBusAddr = R.get(2);
+  Cache.PLL = R.getStr(MaxNameLen);
+  Cache.PLLAddr = R.get(1);
+  unsigned BlockLen = R.get(1);
+  if (BlockLen > MaxBlockLen)
+    return std::nullopt;
+  for (unsigned Idx = 0; Idx != MaxBlockLen; ++Idx) {
+    uint8_t Byte = R.get(1);
+    if (Idx < BlockLen)
+      Cache.PLLBlock.push_back(Byte);
+  }
+  return Cache;
+}
+
+bool DiscoveryCache::save(const std::string &Path) const {
+  std::vector<uint8_t> Bytes;
+  BinWriter W(Bytes);
+  W.put(Magic, 4);
+  W.put(Version, 2);
+  W.put(PayloadLen, 2);
+  // Patched below, once we have the payload.
+  W.put(0, 4);
+  W.put(Fingerprint.ID, 4);
+  W.put(Fingerprint.ClassRev, 4);
+  W.put(Fingerprint.Subsystem, 4);
+  W.putStr(HostBridge, MaxNameLen);
+  W.put(SMBusAddr, 2);
+  W.putStr(PLL, MaxNameLen);
+  W.put(PLLAddr, 1);
+  unsigned BlockLen = std::min<size_t>(PLLBlock.size(), MaxBlockLen);
+  W.put(BlockLen, 1);
+  for (unsigned Idx = 0; Idx != MaxBlockLen; ++Idx)
+    W.put(Idx < BlockLen ? PLLBlock[Idx] : 0, 1);
+  uint32_t Checksum = getBinChecksum(Bytes, HeaderLen);
+  W.patch(8, Checksum, 4);
+
+  std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+  File.write((const char *)Bytes.data(), Bytes.size());
+  File.close();
+  return (bool)File;
+}
+
+void DiscoveryCache::remove(const std::string &Path) {
+  std::remove(Path.c_str());
+}
+
+void DiscoveryCache::print(std::ostream &OS) const {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::hex << "Cached: " << HostBridge << " (" << Fingerprint.ID << " "
+     << Fingerprint.ClassRev << " " << Fingerprint.Subsystem << ") SMBus 0x"
+     << SMBusAddr;
+  if (!PLL.empty()) {
+    OS << " PLL " << PLL << " at 0x" << (int)PLLAddr;
+    for (uint8_t Byte : PLLBlock)
+      OS << " " << std::setw(2) << std::setfill('0') << (int)Byte;
+    OS << std::setfill(' ');
+  }
+  OS.flags(SvFlags);
+}
@@ -0,0 +1,78 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// A small binary file holding what we discovered about the hardware, so that
+// repeated runs (e.g. from AUTOEXEC.BAT) can skip the slow probing.
+//
+
+#ifndef __SRC_CACHE_H__
+#define __SRC_CACHE_H__
+
+#include "pci.h"
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// A few configuration dwords of the host bridge that are cheap to read and
+/// change if the board, the chipset revision or the BIOS setup change.
+struct HWFingerprint {
+  /// The Vendor/Device ID dword.
+  uint32_t ID = 0;
+  /// The Revision/Class dword.
+  uint32_t ClassRev = 0;
+  /// The Subsystem Vendor/Device ID dword.
+  uint32_t Subsystem = 0;
+
+  static constexpr const uint16_t ClassRevReg = 0x08;
+  static constexpr const uint16_t SubsystemReg = 0x2c;
+
+  /// Reads the fingerprint of the host bridge at \p Addr.
+  static HWFingerprint read(const BDF &Addr);
+  bool operator==(const HWFingerprint &Other) const {
+    return ID == Other.ID && ClassRev == Other.ClassRev &&
+           Subsystem == Other.Subsystem;
+  }
+  bool operator!=(const HWFingerprint &Other) const {
+    return !(*this == Other);
+  }
+};
+
+class DiscoveryCache {
+public:
+  /// DOS 8.3 file name, in the current directory.
+  static constexpr const char *DefaultFile = "SISFSB.CAC";
+  /// "SFSC" when read as little-endian.
+  static constexpr const uint32_t Magic = 0x43534653;
+  /// Bump this whenever the layout changes.
+  static constexpr const uint16_t Version = 1;
+  static constexpr const unsigned MaxNameLen = 16;
+  static constexpr const unsigned MaxBlockLen = 32;
+
+  HWFingerprint Fingerprint;
+  /// The name of the host bridge, as registered in Chips.
+  std::string HostBridge;
+  /// The SMBus I/O base address, 0 if not known yet.
+  uint16_t SMBusAddr = 0;
+  /// The name of the PLL, empty if not known yet.
+  std::string PLL;
+  /// The SMBus address of the PLL.
+  uint8_t PLLAddr = 0;
+  /// The PLL register block as last read.
+  std::vector<uint8_t> PLLBlock;
+
+  /// Loads the cache from \p Path. \Returns nullopt if the file is missing,
+  /// corrupt, from a different version or if its fingerprint does not match
+  /// \p Expected.
+  static std::optional<DiscoveryCache> load(const std::string &Path,
+                                            const HWFingerprint &Expected);
+  /// Writes the cache to \p Path. \Returns false on error.
+  bool save(const std::string &Path) const;
+  /// Deletes the cache file at \p Path, if any.
+  static void remove(const std::string &Path);
+  void print(std::ostream &OS) const;
+};
+
+#endif // __SRC_CACHE_H__
@@ -0,0 +1,34 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "chipopt.h"
+#include "utils.h"
+#include <iomanip>
+
+bool ChipsetFeature::setEnabled(const BDF &BDFAddr, bool Enable) const {
+  uint8_t OldReg = PCI::readByte(BDFAddr, Reg);
+  uint8_t NewVal = Enable ? EnableVal : (uint8_t)(~EnableVal & Mask);
+  uint8_t NewReg = (OldReg & ~Mask) | NewVal;
+  if (NewReg == OldReg)
+    return true;
+  PCI::writeByte(BDFAddr, Reg, NewReg);
+  if (isEnabled(BDFAddr) != Enable) {
+    std::cerr << Name << ": register 0x" << std::hex << (int)Reg
+              << " did not accept 0x" << (int)NewReg << std::dec
+              << ", restoring" << std::endl;
+    PCI::writeByte(BDFAddr, Reg, OldReg);
+    return false;
+  }
+  return true;
+}
+
+void ChipsetFeature::print(std::ostream &OS) const {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::left << std::setw(22) << Name << std::right << " Reg 0x"
+     << std::hex << std::setw(2) << std::setfill('0') << (int)Reg << " Mask 0x"
+     << std::setw(2) << (int)Mask << std::setfill(' ')
+     << (Safe ? " [safe] " : "        ") << Description;
+  OS.flags(SvFlags);
+}
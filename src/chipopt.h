@@ -0,0 +1,37 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Performance related chipset configuration bits, like posted writes and
+// prefetching, that the BIOS may leave disabled.
+//
+
+#ifndef __SRC_CHIPOPT_H__
+#define __SRC_CHIPOPT_H__
+
+#include "pci.h"
+#include <cstdint>
+#include <iostream>
+
+/// A feature controlled by one or more bits of a configuration register.
+struct ChipsetFeature {
+  const char *Name;
+  const char *Description;
+  uint8_t Reg;
+  /// The bits that control the feature.
+  uint8_t Mask;
+  /// The value of the `Mask` bits when the feature is enabled.
+  uint8_t EnableVal;
+  /// Whether the bits have been checked against the datasheet. Only safe
+  /// features can be changed, either by "enable"/"disable" or by "profile".
+  bool Safe;
+
+  bool isEnabled(const BDF &BDFAddr) const {
+    return (PCI::readByte(BDFAddr, Reg) & Mask) == EnableVal;
+  }
+  /// Sets the feature and reads it back. \Returns false if it did not stick.
+  bool setEnabled(const BDF &BDFAddr, bool Enable) const;
+  void print(std::ostream &OS) const;
+};
+
+#endif // __SRC_CHIPOPT_H__
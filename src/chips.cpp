@@ -6,62 +6,135 @@
 //
 
 #include "chips.h"
+#include "timing.h"
 #include "utils.h"
+#include <cmath>
 #include <memory>
 
 std::optional<uint16_t> SiS540::getSMBusAddr() const {
+  PhaseTimer Phase("lpc-acpi");
   // The SMBus address is found in the LPC function block.
   // So first check if LPC responds.
   uint16_t FoundVendorID = PCI::readWord(LPC.getBDF(), PCI::VendorIdReg);
   if (FoundVendorID != LPC.getVendorID()) {
     std::cerr << "Found LPC Vendor ID " << FoundVendorID << " expected "
-              << getVendorID() << std::endl;
+              << getVendorID() << '\n';
     return std::nullopt;
   }
   uint16_t FoundDeviceID = PCI::readWord(LPC.getBDF(), PCI::DeviceIdReg);
   if (FoundDeviceID != LPC.getDeviceID()) {
     std::cerr << "Found LPC Device ID " << FoundDeviceID << " expected "
-              << LPC.getDeviceID() << std::endl;
+              << LPC.getDeviceID() << '\n';
     return std::nullopt;
   }
   // OK so we can now access LPC.
   // Enable ACPI by setting a bit in the BiosCtrlReg of LPC.
   uint8_t BCR = PCI::readByte(LPC.getBDF(), LPC_BiosCtrlReg);
-  if (Debug)
-    std::cout << "BiosCtrlReg=0x" << BCR << std::endl;
+  if (isDebug())
+    std::cout << "BiosCtrlReg=0x" << BCR << '\n';
   if (!(BCR & LPC_EnableACPIMask)) {
     PCI::writeByte(LPC.getBDF(), LPC_BiosCtrlReg, BCR | LPC_EnableACPIMask);
     BCR = PCI::readByte(LPC.getBDF(), LPC_BiosCtrlReg);
   }
   // Early return if we could not enable ACPI.
   if (!(BCR & LPC_EnableACPIMask)) {
-    std::cerr << "Could not enable ACPI!" << std::endl;
+    std::cerr << "Could not enable ACPI!" << '\n';
     return std::nullopt;
   }
   // The SMBus address is in LPC at LPC_ACPIBaseAddrReg.
   uint16_t Addr = PCI::readWord(LPC.getBDF(), LPC_ACPIBaseAddrReg);
   if (Addr == 0xffff || Addr == 0) {
     std::cerr << "Found bad SMBus address in LPC at "
-              << (int)LPC_ACPIBaseAddrReg << std::endl;
+              << (int)LPC_ACPIBaseAddrReg << '\n';
     return std::nullopt;
   }
   std::cout << "Found SMBus addr: " << Addr << "\n";
   return Addr;
 }
 
-bool SiS540::initSMB() {
+const std::vector<DRAMTimingField> SiS540::DRAMTimings = {
+    {"cas-latency", DRAMTimingField::Kind::CASLatency, /*Reg=*/0x52,
+     /*LSB=*/2, /*Width=*/1, {{0, 3}, {1, 2}}},
+    {"ras-to-cas", DRAMTimingField::Kind::RASToCAS, /*Reg=*/0x52,
+     /*LSB=*/1, /*Width=*/1, {{0, 3}, {1, 2}}},
+    {"ras-precharge", DRAMTimingField::Kind::RASPrecharge, /*Reg=*/0x52,
+     /*LSB=*/0, /*Width=*/1, {{0, 3}, {1, 2}}},
+    {"refresh", DRAMTimingField::Kind::Refresh, /*Reg=*/0x54,
+     /*LSB=*/0, /*Width=*/2, {{0, 15600}, {1, 7800}, {2, 3900}}},
+};
+
+const ChipsetFeature *
+HostToPCIBridge::findChipsetFeature(const std::string &Name) const {
+  for (const ChipsetFeature &Feature : getChipsetFeatures())
+    if (Feature.Name == Name)
+      return &Feature;
+  return nullptr;
+}
+
+const std::vector<ChipsetFeature> SiS540::ChipsetFeatures = {
+    {"cpu-pci-posted-write", "CPU to PCI posted write buffer", /*Reg=*/0x70,
+     /*Mask=*/0x01, /*EnableVal=*/0x01, /*Safe=*/false},
+    {"pci-prefetch", "PCI master read prefetching from DRAM", /*Reg=*/0x70,
+     /*Mask=*/0x02, /*EnableVal=*/0x02, /*Safe=*/false},
+    {"mem-read-pipeline", "CPU memory read pipelining", /*Reg=*/0x53,
+     /*Mask=*/0x10, /*EnableVal=*/0x10, /*Safe=*/false},
+    {"pci-burst-write", "CPU to PCI burst write combining", /*Reg=*/0x70,
+     /*Mask=*/0x04, /*EnableVal=*/0x04, /*Safe=*/false},
+    {"pci-fast-back-to-back", "CPU to PCI fast back-to-back cycles",
+     /*Reg=*/0x70, /*Mask=*/0x08, /*EnableVal=*/0x08, /*Safe=*/false},
+};
+
+bool SiS540::isACPIEnabled() const {
+  return PCI::readByte(LPC.getBDF(), LPC_BiosCtrlReg) & LPC_EnableACPIMask;
+}
+
+bool SiS540::initSMB(std::optional<uint16_t> KnownAddr) {
+  // The BIOS may have turned ACPI off again since we cached the address.
+  if (KnownAddr && isACPIEnabled()) {
+    SMB = std::make_unique<SiSSMBus>(*KnownAddr);
+    return true;
+  }
   std::optional<uint16_t> SMBAddr = getSMBusAddr();
   if (! SMBAddr)
     return false;
-  SMB = std::make_unique<SiSSMBus>(*SMBAddr, PLL::SlaveAddr);
+  SMB = std::make_unique<SiSSMBus>(*SMBAddr);
   return true;
 }
 
+unsigned PLLSignature::getConfidence(const std::vector<uint8_t> &Block) const {
+  if (empty())
+    return 0;
+  unsigned Total = 0;
+  unsigned Matched = 0;
+  auto CheckBits = [&Block, &Total, &Matched](const std::vector<Bits> &BitsVec,
+                                             unsigned Weight) {
+    for (const Bits &B : BitsVec) {
+      for (unsigned Bit = 0; Bit != 8; ++Bit) {
+        uint8_t BitMask = 1u << Bit;
+        if (!(B.Mask & BitMask))
+          continue;
+        Total += Weight;
+        if (B.Byte < Block.size() &&
+            (Block[B.Byte] & BitMask) == (B.Val & BitMask))
+          Matched += Weight;
+      }
+    }
+  };
+  if (ByteCount != 0) {
+    Total += ByteCountWeight;
+    if (Block.size() == ByteCount)
+      Matched += ByteCountWeight;
+  }
+  CheckBits(FixedBits, FixedBitWeight);
+  CheckBits(IDBytes, IDBitWeight);
+  return Matched * 100 / Total;
+}
+
 void PLL::dumpFreqTable(std::ostream &OS) const {
-  OS << "FreqTable FSB/SDRAM/PCI   Divider" << std::endl;
+  OS << "FreqTable FSB/SDRAM/PCI   Divider" << '\n';
   for (auto [Key, FE] : FreqTable)
     OS << std::setw(2) << (int)Key << "    : " << FE
-       << std::endl;
+       << '\n';
 }
 
 uint8_t PLL::getKey(uint8_t KeyRegVal) const {
@@ -76,16 +149,27 @@ uint8_t PLL::getKey(uint8_t KeyRegVal) const {
 }
 
 std::optional<uint8_t> PLL::lookupKey(const FreqEntry &FE) const {
+  // Several entries may be within the FreqEntry tolerance (e.g. 95.2, 96.2 and
+  // 97.0), so pick the closest one. This matters when ramping through them.
+  std::optional<uint8_t> BestKey;
+  float BestDist = 0;
   for (auto &[Key, TableFE] : FreqTable) {
-    if (TableFE == FE)
-      return Key;
+    if (!(TableFE == FE))
+      continue;
+    float Dist = std::abs(TableFE.getFsb() - FE.getFsb()) +
+                 std::abs(TableFE.getSdram() - FE.getSdram()) +
+                 std::abs(TableFE.getPci() - FE.getPci());
+    if (!BestKey || Dist < BestDist) {
+      BestKey = Key;
+      BestDist = Dist;
+    }
   }
-  return std::nullopt;
+  return BestKey;
 }
 
 uint8_t PLL::encodeKey(uint8_t OrigKeyReg, uint8_t Key) const {
   uint8_t NewKeyReg = OrigKeyReg;
-  for (int Bit = 0; Bit != 8; ++Bit) {
+  for (int Bit = 0, E = KeyBits.size(); Bit != E; ++Bit) {
     bool IsOne = Key & 0x1 << Bit;
     int Shift = KeyBits[Bit];
     if (IsOne)
@@ -97,30 +181,31 @@ uint8_t PLL::encodeKey(uint8_t OrigKeyReg, uint8_t Key) const {
 }
 
 std::optional<FreqEntry> PLL::getFSB(SMBus &SMB) const {
-  auto ReadVec = SMB.readBlockData(KeyRegister, Cmd);
+  auto ReadVec = SMB.readBlockData(Addr, Cmd);
   if (ReadVec.empty()) {
     std::cerr << "Could not read block from PLL (Reg=0x" << KeyRegister << ")"
-              << std::endl;
+              << '\n';
     return std::nullopt;
   }
-  if (Debug) {
+  LastBlock = ReadVec;
+  if (isDebug()) {
     std::cout << "ReadVec: ";
     for (auto Byte : ReadVec)
       std::cout << "0x" << (int)Byte << " ";
-    std::cout << std::endl;
+    std::cout << '\n';
   }
 
   uint8_t Reg = ReadVec[0];
   uint8_t Key = getKey(Reg);
-  if (Debug) {
+  if (isDebug()) {
     DecimalGuard(std::cout);
-    std::cout << "PLL Reg=" << (int)Reg << " Key=" << (int)Key << std::endl;
+    std::cout << "PLL Reg=" << (int)Reg << " Key=" << (int)Key << '\n';
   }
   auto It = FreqTable.find(Key);
   if (It == FreqTable.end()) {
-    if (Debug) {
+    if (isDebug()) {
       DecimalGuard(std::cerr);
-      std::cerr << "Key " << (int)Key << " not found in FreqTable" << std::endl;
+      std::cerr << "Key " << (int)Key << " not found in FreqTable" << '\n';
     }
     dumpFreqTable(std::cerr);
     return std::nullopt;
@@ -128,91 +213,317 @@ std::optional<FreqEntry> PLL::getFSB(SMBus &SMB) const {
   return It->second;
 }
 
-bool PLL::setFSB(const FreqEntry &FE, SMBus &SMB) {
+std::vector<uint8_t> PLL::getFSBBlock(const FreqEntry &FE, SMBus &SMB) const {
   std::optional<uint8_t> KeyOpt = lookupKey(FE);
   if (!KeyOpt) {
-    std::cerr << "Could not find " << FE << " in FreqTable." << std::endl;
+    std::cerr << "Could not find " << FE << " in FreqTable." << '\n';
     dumpFreqTable(std::cerr);
-    return false;
+    return {};
   }
   uint8_t Key = *KeyOpt;
-  if (Debug)
-    std::cout << "PLL Key = 0x" << (int)Key << std::endl;
-  auto OldKeyVec = SMB.readBlockData(KeyRegister, Cmd);
+  if (isDebug())
+    std::cout << "PLL Key = 0x" << (int)Key << '\n';
+  auto OldKeyVec = SMB.readBlockData(Addr, Cmd);
   if (OldKeyVec.empty()) {
-    std::cerr << "Could not read original Key Reg." << std::endl;
-    return false;
+    std::cerr << "Could not read original Key Reg." << '\n';
+    return {};
   }
-  if (Debug)
-    std::cout << "PLL OldKeyVec[0] = 0x" << (int)OldKeyVec[0] << std::endl;
+  if (isDebug())
+    std::cout << "PLL OldKeyVec[0] = 0x" << (int)OldKeyVec[0] << '\n';
 
   uint8_t NewKeyReg = encodeKey(OldKeyVec[0], Key);
-  std::cout << "PLL NewKeyReg = 0x" << (int)NewKeyReg << std::endl;
-  std::vector<uint8_t> Data = {NewKeyReg};
-  if (!SMB.writeBlockData(KeyRegister, Cmd, Data)) {
-    std::cerr << "Failed to write block data to PLL" << std::endl;
+  std::cout << "PLL NewKeyReg = 0x" << (int)NewKeyReg << '\n';
+  return {NewKeyReg};
+}
+
+bool PLL::setFSB(const FreqEntry &FE, SMBus &SMB) {
+  std::vector<uint8_t> Data = getFSBBlock(FE, SMB);
+  if (Data.empty())
+    return false;
+  PhaseTimer Phase("pll-write");
+  if (!SMB.writeBlockData(Addr, Cmd, Data)) {
+    std::cerr << "Failed to write block data to PLL" << '\n';
     return false;
   }
 
-  if (Debug)
-    std::cout << "PLL Enabling I2C" << std::endl;
-  setEnabled(true, SMB);
-  return true;
+  if (isDebug())
+    std::cout << "PLL Enabling I2C" << '\n';
+  Phase.next("pll-enable");
+  return setEnabled(true, SMB);
 }
 
-static uint8_t getReg(unsigned Reg, SMBus &SMB) {
-  if (Debug)
-    std::cout << __FUNCTION__ << "(" << Reg << ")" << std::endl;
-  auto RegVec = SMB.readBlockData(Reg, PLL::Cmd);
-  if (RegVec.empty()) {
-    std::cerr << __FUNCTION__ << " Failed to get the enabled bit." << std::endl;
-    exit(1);
+std::vector<FreqEntry> PLL::getRampPath(const FreqEntry &From,
+                                        const FreqEntry &To) const {
+  // Ramping down is the same as ramping up from `To` in reverse.
+  if (To.getFsb() < From.getFsb()) {
+    auto Path = getRampPath(To, From);
+    std::reverse(Path.begin(), Path.end());
+    return Path;
   }
-  uint8_t RegVal = RegVec[0];
-  if (Debug)
-    std::cout << __FUNCTION__ << " Reg = 0x" << (int)RegVal << std::endl;
+  float MaxSdram = std::max(From.getSdram(), To.getSdram());
+  float MaxPci = std::max(From.getPci(), To.getPci());
+  std::vector<FreqEntry> Candidates;
+  for (const auto &[Key, FE] : FreqTable) {
+    if (FE.getFsb() <= From.getFsb() || FE.getFsb() >= To.getFsb())
+      continue;
+    if (FE.getSdram() > MaxSdram || FE.getPci() > MaxPci)
+      continue;
+    Candidates.push_back(FE);
+  }
+  // Sort by FSB and for the same FSB prefer the lower SDRAM.
+  std::sort(Candidates.begin(), Candidates.end(),
+            [](const FreqEntry &A, const FreqEntry &B) {
+              if (A.getFsb() != B.getFsb())
+                return A.getFsb() < B.getFsb();
+              return A.getSdram() < B.getSdram();
+            });
+  std::vector<FreqEntry> Path;
+  float LastFsb = From.getFsb();
+  float LastSdram = From.getSdram();
+  for (const FreqEntry &FE : Candidates) {
+    // Only one entry per FSB step, and never step the SDRAM back down.
+    if (FE.getFsb() == LastFsb || FE.getSdram() < LastSdram)
+      continue;
+    Path.push_back(FE);
+    LastFsb = FE.getFsb();
+    LastSdram = FE.getSdram();
+  }
+  return Path;
+}
+
+static std::optional<uint8_t> getReg(uint8_t Addr, unsigned Reg, SMBus &SMB) {
+  if (isDebug())
+    std::cout << __FUNCTION__ << "(" << Reg << ")" << '\n';
+  auto RegVec = SMB.readBlockData(Addr, PLL::Cmd);
+  if (RegVec.size() <= Reg) {
+    std::cerr << __FUNCTION__ << " Failed to get the enabled bit." << '\n';
+    return std::nullopt;
+  }
+  uint8_t RegVal = RegVec[Reg];
+  if (isDebug())
+    std::cout << __FUNCTION__ << " Reg = 0x" << (int)RegVal << '\n';
   return RegVal;
 }
 
 bool PLL::getEnabled(SMBus &SMB) const {
   uint8_t EnableI2CMask = (uint8_t)0x1 << EnableI2CBit;
-  bool Enabled = getReg(EnableI2CRegister, SMB) & EnableI2CMask;
-  if (Debug)
-    std::cout << "PLL Enabled = " << Enabled << std::endl;
+  std::optional<uint8_t> Reg = getReg(Addr, EnableI2CRegister, SMB);
+  bool Enabled = Reg && (*Reg & EnableI2CMask);
+  if (isDebug())
+    std::cout << "PLL Enabled = " << Enabled << '\n';
   return Enabled;
 }
 
-void PLL::setEnabled(bool NewVal, SMBus &SMB) const {
-  if (Debug)
-    std::cout << "PLL setEnabled(" << NewVal << ")" << std::endl;
-  uint8_t OldReg = getReg(EnableI2CRegister, SMB);
+bool PLL::setEnabled(bool NewVal, SMBus &SMB) const {
+  if (isDebug())
+    std::cout << "PLL setEnabled(" << NewVal << ")" << '\n';
+  auto Block = SMB.readBlockData(Addr, Cmd);
+  if (Block.size() <= EnableI2CRegister) {
+    std::cerr << "PLL Failed to get the enabled bit." << '\n';
+    return false;
+  }
   uint8_t EnableI2CMask = (uint8_t)0x1 << EnableI2CBit;
-  uint8_t NewReg = OldReg | EnableI2CMask;
-  if (Debug)
-    std::cout << "PLL NewReg = 0x" << (int)NewReg << std::endl;
-  bool Success = SMB.writeBlockData(EnableI2CRegister, Cmd, {NewReg});
-  if (!Success) {
-    std::cerr << "PLL Failed to set the enabled bit." << std::endl;
-    exit(1);
+  uint8_t &Reg = Block[EnableI2CRegister];
+  Reg = NewVal ? Reg | EnableI2CMask : Reg & ~EnableI2CMask;
+  if (isDebug())
+    std::cout << "PLL NewReg = 0x" << (int)Reg << '\n';
+  // A block write always starts at byte 0, so write back the bytes before the
+  // enable register unchanged.
+  Block.resize(EnableI2CRegister + 1);
+  if (!SMB.writeBlockData(Addr, Cmd, Block)) {
+    std::cerr << "PLL Failed to set the enabled bit." << '\n';
+    return false;
   }
+  return true;
 }
 
-bool PLL::check(HostToPCIBridge &HB) const {
-  SMBus &SMB = HB.getSMB();
-  if (!SMB.writeQuick(0)) {
-    std::cerr << "PLL Failed writeQuick()!" << std::endl;
+bool PLL::check(SMBus &SMB) const {
+  if (!SMB.writeQuick(Addr)) {
+    std::cerr << "PLL Failed writeQuick()!" << '\n';
     return false;
   }
   return true;
 }
 
+unsigned MNPLL::getField(const std::vector<uint8_t> &Block,
+                         const MultiRegField &Field) {
+  unsigned Val = 0;
+  unsigned Shift = 0;
+  for (const RegField &F : Field) {
+    unsigned Mask = (1u << F.Width) - 1;
+    Val |= ((Block[F.Byte] >> F.LSB) & Mask) << Shift;
+    Shift += F.Width;
+  }
+  return Val;
+}
+
+void MNPLL::setField(std::vector<uint8_t> &Block, const MultiRegField &Field,
+                     unsigned Val) {
+  for (const RegField &F : Field) {
+    unsigned Mask = (1u << F.Width) - 1;
+    Block[F.Byte] &= ~(Mask << F.LSB);
+    Block[F.Byte] |= (Val & Mask) << F.LSB;
+    Val >>= F.Width;
+  }
+}
+
+unsigned MNPLL::getBlockSize() const {
+  unsigned MaxByte = std::max(KeyRegister, EnableI2CRegister);
+  for (const MultiRegField *Field : {&M.Field, &N.Field, &PostDivField})
+    for (const RegField &F : *Field)
+      MaxByte = std::max(MaxByte, (unsigned)F.Byte);
+  MaxByte = std::max(MaxByte, (unsigned)MNEnableBit.Byte);
+  return MaxByte + 1;
+}
+
+uint8_t MNPLL::lookupRatioKey(const FreqEntry &FE) const {
+  uint8_t BestKey = FreqTable.begin()->first;
+  float BestDist = 0;
+  bool First = true;
+  for (const auto &[Key, TableFE] : FreqTable) {
+    float Dist =
+        std::abs(TableFE.getSdram() / TableFE.getFsb() -
+                 FE.getSdram() / FE.getFsb()) +
+        std::abs(TableFE.getPci() / TableFE.getFsb() - FE.getPci() / FE.getFsb());
+    if (First || Dist < BestDist) {
+      BestKey = Key;
+      BestDist = Dist;
+      First = false;
+    }
+  }
+  return BestKey;
+}
+
+std::pair<float, float> MNPLL::getFsbRange() const {
+  unsigned MinPostDiv = PostDivs.begin()->second;
+  unsigned MaxPostDiv = MinPostDiv;
+  for (const auto &[RegVal, Div] : PostDivs) {
+    MinPostDiv = std::min(MinPostDiv, Div);
+    MaxPostDiv = std::max(MaxPostDiv, Div);
+  }
+  return {VCOMinMHz / MaxPostDiv, VCOMaxMHz / MinPostDiv};
+}
+
+std::optional<MNPLL::Solution> MNPLL::solve(float FsbMHz) const {
+  std::optional<Solution> Best;
+  for (const auto &[PostDivRegVal, PostDiv] : PostDivs) {
+    float VCO = FsbMHz * PostDiv;
+    if (VCO < VCOMinMHz || VCO > VCOMaxMHz)
+      continue;
+    // For each M there is only one N worth trying: the closest one.
+    for (unsigned MVal = M.Min; MVal <= M.Max; ++MVal) {
+      long NVal = std::lround(VCO * MVal / RefClockMHz);
+      if (NVal < (long)N.Min || NVal > (long)N.Max)
+        continue;
+      float ActualVCO = RefClockMHz * NVal / MVal;
+      if (ActualVCO < VCOMinMHz || ActualVCO > VCOMaxMHz)
+        continue;
+      float Fsb = ActualVCO / PostDiv;
+      if (!Best || std::abs(Fsb - FsbMHz) < std::abs(Best->FsbMHz - FsbMHz))
+        Best = Solution{MVal, (unsigned)NVal, PostDivRegVal, Fsb};
+    }
+  }
+  return Best;
+}
+
+void MNPLL::dumpFreqTable(std::ostream &OS) const {
+  PLL::dumpFreqTable(OS);
+  auto [MinFsb, MaxFsb] = getFsbRange();
+  DecimalGuard DG(OS);
+  OS << std::fixed << std::setprecision(1);
+  OS << "M/N programmable FSB: " << MinFsb << " - " << MaxFsb
+     << " MHz, using the table entry with the closest SDRAM/PCI ratios"
+     << '\n';
+}
+
+std::optional<FreqEntry> MNPLL::getFSB(SMBus &SMB) const {
+  auto Block = SMB.readBlockData(Addr, Cmd);
+  if (Block.size() < getBlockSize()) {
+    std::cerr << "Could not read " << getBlockSize() << " bytes from PLL"
+              << '\n';
+    return std::nullopt;
+  }
+  LastBlock = Block;
+  auto It = FreqTable.find(getKey(Block[KeyRegister]));
+  if (It == FreqTable.end()) {
+    dumpFreqTable(std::cerr);
+    return std::nullopt;
+  }
+  const FreqEntry &Ratios = It->second;
+  // If the dividers are not in use then the table entry is the actual FSB.
+  if (!getField(Block, {MNEnableBit}))
+    return Ratios;
+  unsigned MVal = getField(Block, M.Field) + M.Offset;
+  unsigned NVal = getField(Block, N.Field) + N.Offset;
+  auto PostDivIt = PostDivs.find(getField(Block, PostDivField));
+  if (MVal == 0 || PostDivIt == PostDivs.end()) {
+    std::cerr << "Bad PLL dividers M=" << MVal << '\n';
+    return std::nullopt;
+  }
+  float Fsb = RefClockMHz * NVal / MVal / PostDivIt->second;
+  if (isDebug()) {
+    DecimalGuard DG(std::cout);
+    std::cout << "PLL M=" << MVal << " N=" << NVal
+              << " PostDiv=" << PostDivIt->second << '\n';
+  }
+  return FreqEntry(Fsb, Fsb * Ratios.getSdram() / Ratios.getFsb(),
+                   Fsb * Ratios.getPci() / Ratios.getFsb());
+}
+
+std::vector<uint8_t> MNPLL::getFSBBlock(const FreqEntry &FE,
+                                        SMBus &SMB) const {
+  std::optional<Solution> Sol = solve(FE.getFsb());
+  if (!Sol) {
+    auto [MinFsb, MaxFsb] = getFsbRange();
+    DecimalGuard DG(std::cerr);
+    std::cerr << "FSB " << FE.getFsb() << " outside of the PLL range "
+              << MinFsb << " - " << MaxFsb << '\n';
+    return {};
+  }
+  uint8_t Key = lookupRatioKey(FE);
+  {
+    DecimalGuard DG(std::cout);
+    std::cout << std::fixed << std::setprecision(2) << "PLL M=" << Sol->M
+              << " N=" << Sol->N << " FSB=" << Sol->FsbMHz << " Ratios=" << FreqTable.at(Key)
+              << '\n';
+  }
+  auto Block = SMB.readBlockData(Addr, Cmd);
+  if (Block.size() < getBlockSize()) {
+    std::cerr << "Could not read original PLL registers." << '\n';
+    return {};
+  }
+  Block.resize(getBlockSize());
+  Block[KeyRegister] = encodeKey(Block[KeyRegister], Key);
+  setField(Block, M.Field, Sol->M - M.Offset);
+  setField(Block, N.Field, Sol->N - N.Offset);
+  setField(Block, PostDivField, Sol->PostDivRegVal);
+  setField(Block, {MNEnableBit}, 1);
+  return Block;
+}
+
+std::vector<FreqEntry> MNPLL::getRampPath(const FreqEntry &From,
+                                          const FreqEntry &To) const {
+  // Use the lower of the two ratios for all intermediate steps so that SDRAM
+  // and PCI never overshoot. The last step switches to the target ratios.
+  float SdramRatio =
+      std::min(From.getSdram() / From.getFsb(), To.getSdram() / To.getFsb());
+  float PciRatio =
+      std::min(From.getPci() / From.getFsb(), To.getPci() / To.getFsb());
+  float Step = To.getFsb() > From.getFsb() ? RampStepMHz : -RampStepMHz;
+  std::vector<FreqEntry> Path;
+  for (float Fsb = From.getFsb() + Step;
+       Step > 0 ? Fsb < To.getFsb() : Fsb > To.getFsb(); Fsb += Step)
+    Path.push_back(FreqEntry(Fsb, Fsb * SdramRatio, Fsb * PciRatio));
+  return Path;
+}
+
 void Chips::registerChips() {
   // Register Host-to-pci bridges.
   HostBridges.push_back(std::make_unique<SiS540>());
 
   // Register PLLs.
   int Key = 0;
-  PLLs.push_back(PLL(
+  PLLs.push_back(std::unique_ptr<PLL>(new PLL(
       /*Name=*/"W83194R-630A",
       /*KeyRegister=*/0,
       /*KeyBits=*/{4, 5, 6, 2},
@@ -235,13 +546,16 @@ void Chips::registerChips() {
           {Key++, {166.00, 166.00, 33.3}},
       },
       /*EnableI2CRegister=*/0,
-      /*EnableI2cBit=*/3));
+      /*EnableI2cBit=*/3,
+      // No signature: the datasheet lists neither the reserved bit values
+      // nor a vendor ID byte, so -pll auto can't detect this one.
+      /*Signature=*/{})));
 }
 
 void Chips::listHostBridges(std::ostream &OS) const {
-  OS << "Supported Host Bridges:" << std::endl;
+  OS << "Supported Host Bridges:" << '\n';
   for (const auto &HBPtr : HostBridges) {
-    OS << *HBPtr << std::endl;
+    OS << *HBPtr << '\n';
   }
 }
 
@@ -259,23 +573,90 @@ HostToPCIBridge *Chips::findHostBridge() const {
     break;
   }
   if (HB == nullptr) {
-    std::cerr << "Failed to find a supported Host Bridge!" << std::endl;
+    std::cerr << "Failed to find a supported Host Bridge!" << '\n';
     listHostBridges(std::cerr);
     return nullptr;
   }
-  std::cout << "Host bridge found: " << *HB << std::endl;
+  std::cout << "Host bridge found: " << *HB << '\n';
   return HB;
 }
 
+HostToPCIBridge *Chips::getHostBridge(const std::string &Name) const {
+  for (const auto &HBPtr : HostBridges)
+    if (HBPtr->getName() == Name)
+      return HBPtr.get();
+  return nullptr;
+}
+
 PLL *Chips::findPLL(const std::string &PLLName) {
-  auto It = std::find_if(PLLs.begin(), PLLs.end(), [&PLLName](const PLL &P) {
-    return toLower(P.getName()) == toLower(PLLName);
-  });
+  auto It = std::find_if(PLLs.begin(), PLLs.end(),
+                         [&PLLName](const std::unique_ptr<PLL> &P) {
+                           return toLower(P->getName()) == toLower(PLLName);
+                         });
   if (It == PLLs.end()) {
-    std::cerr << "PLL '" << PLLName << "' not supported!" << std::endl;
+    std::cerr << "PLL '" << PLLName << "' not supported!" << '\n';
+    return nullptr;
+  }
+  return It->get();
+}
+
+PLL *Chips::detectPLL(SMBus &SMB) {
+  // Below this we don't trust the match enough to program the PLL.
+  static constexpr const unsigned MinConfidence = 75;
+  // Don't poke at the clock generator addresses for nothing.
+  if (std::none_of(PLLs.begin(), PLLs.end(),
+                   [](const auto &P) { return P->hasSignature(); })) {
+    std::cerr << "None of the supported PLLs has a signature to detect it by, "
+                 "please use -pll <PLL>"
+              << '\n';
+    listSupportedPLLs(std::cerr);
+    return nullptr;
+  }
+  std::vector<uint8_t> Addrs = {PLL::SlaveAddr};
+  Addrs.insert(Addrs.end(), std::begin(PLL::AltSlaveAddrs),
+               std::end(PLL::AltSlaveAddrs));
+  PLL *Best = nullptr;
+  uint8_t BestAddr = 0;
+  unsigned BestConfidence = 0;
+  bool Ambiguous = false;
+  for (uint8_t Addr : Addrs) {
+    auto Block = SMB.readBlockData(Addr, PLL::Cmd);
+    if (Block.empty())
+      continue;
+    std::cout << "Clock generator at 0x" << (int)Addr << ":";
+    for (uint8_t Byte : Block)
+      std::cout << " " << std::setw(2) << std::setfill('0') << (int)Byte;
+    std::cout << std::setfill(' ') << '\n';
+    for (const auto &P : PLLs) {
+      if (!P->hasSignature())
+        continue;
+      unsigned Confidence = P->getConfidence(Block);
+      {
+        DecimalGuard DG(std::cout);
+        std::cout << "  " << std::setw(16) << std::left << P->getName()
+                  << std::right << " " << Confidence << "%" << '\n';
+      }
+      if (Confidence > BestConfidence) {
+        Best = P.get();
+        BestAddr = Addr;
+        BestConfidence = Confidence;
+        Ambiguous = false;
+      } else if (Confidence == BestConfidence && P.get() != Best) {
+        Ambiguous = true;
+      }
+    }
+  }
+  if (Best == nullptr || BestConfidence < MinConfidence || Ambiguous) {
+    std::cerr << "Could not auto-detect the PLL, please use -pll <PLL>"
+              << '\n';
+    listSupportedPLLs(std::cerr);
     return nullptr;
   }
-  return &*It;
+  Best->setAddr(BestAddr);
+  std::cout << "Detected PLL: " << *Best << " at 0x" << (int)BestAddr;
+  DecimalGuard DG(std::cout);
+  std::cout << " (confidence " << BestConfidence << "%)" << '\n';
+  return Best;
 }
 
 bool Chips::supportPLL(const std::string &PLLName) {
@@ -283,8 +664,8 @@ bool Chips::supportPLL(const std::string &PLLName) {
 }
 
 void Chips::listSupportedPLLs(std::ostream &OS) const {
-  OS << "Supported PLLs:" << std::endl;
+  OS << "Supported PLLs:" << '\n';
   for (const auto &PLL : PLLs) {
-    OS << "  " << PLL.getName() << std::endl;
+    OS << "  " << PLL->getName() << '\n';
   }
 }
@@ -8,6 +8,9 @@
 #ifndef __SRC_CHIPS_H__
 #define __SRC_CHIPS_H__
 
+#include "chipopt.h"
+#include "clock.h"
+#include "dram.h"
 #include "freqentry.h"
 #include "pci.h"
 #include "smbus.h"
@@ -95,10 +98,33 @@ protected:
         SMBusBaseReg(SMBusBaseReg) {}
 
 public:
-  /// Find the SMBus address and create the SMB object.
-  virtual bool initSMB() = 0;
+  /// Find the SMBus address and create the SMB object. If \p KnownAddr is
+  /// set (e.g. from the discovery cache) and the SMBus is still enabled, then
+  /// it is used instead of looking it up.
+  virtual bool initSMB(std::optional<uint16_t> KnownAddr = std::nullopt) = 0;
 
   SMBus &getSMB() { return *SMB; }
+
+  /// \Returns the I/O port of the ACPI PM timer, or nullopt if we don't know
+  /// where it is. Valid after initSMB().
+  virtual std::optional<uint16_t> getPMTimerPort() const {
+    return std::nullopt;
+  }
+
+  /// \Returns the DRAM timing fields in our configuration space.
+  virtual const std::vector<DRAMTimingField> &getDRAMTimings() const {
+    static const std::vector<DRAMTimingField> None;
+    return None;
+  }
+
+  /// \Returns the performance features in our configuration space.
+  virtual const std::vector<ChipsetFeature> &getChipsetFeatures() const {
+    static const std::vector<ChipsetFeature> None;
+    return None;
+  }
+  /// \Returns the feature named \p Name or null if not found.
+  const ChipsetFeature *findChipsetFeature(const std::string &Name) const;
+
   void printHB(std::ostream &OS) const {
     OS << "SMBus:" << (int)SMBusBaseReg;
   }
@@ -114,6 +140,17 @@ class SiS540 : public HostToPCIBridge {
   static constexpr const uint16_t LPC_ACPIBaseAddrReg = 0x74;
 
   std::optional<uint16_t> getSMBusAddr() const override;
+  /// \Returns true if the ACPI I/O space (and therefore the SMBus) is
+  /// enabled in the LPC.
+  bool isACPIEnabled() const;
+
+  /// The SDRAM timing fields. Their positions have not been checked against
+  /// the datasheet yet, which is fine as -dram only shows them.
+  static const std::vector<DRAMTimingField> DRAMTimings;
+  /// The posted write, prefetch and pipelining bits. Their positions have not
+  /// been checked against the datasheet yet, so none of them is Safe and
+  /// -chipset-opt only shows them.
+  static const std::vector<ChipsetFeature> ChipsetFeatures;
 
 public:
   SiS540()
@@ -122,7 +159,20 @@ public:
                         /*SMBusBaseReg=*/0x80),
         LPC("SiSLPC", getVendorID(), /*DeviceID=*/0x0008, BDF(0, 1, 8)) {}
 
-  bool initSMB() override;
+  bool initSMB(std::optional<uint16_t> KnownAddr = std::nullopt) override;
+  /// The SMBus address is the ACPI I/O base, the SMBus registers start at
+  /// SMBusBaseReg in it.
+  std::optional<uint16_t> getPMTimerPort() const override {
+    if (!SMB)
+      return std::nullopt;
+    return SMB->getBaseAddr() + ACPIPMTimer::Offset;
+  }
+  const std::vector<DRAMTimingField> &getDRAMTimings() const override {
+    return DRAMTimings;
+  }
+  const std::vector<ChipsetFeature> &getChipsetFeatures() const override {
+    return ChipsetFeatures;
+  }
   void print(std::ostream &OS) const override {
     static_cast<FunctionBlock>(*this).print(OS);
     OS << " ";
@@ -130,6 +180,34 @@ public:
   }
 };
 
+/// Describes what a PLL's register block looks like when read over SMBus, so
+/// that we can tell PLLs apart without the user naming them.
+struct PLLSignature {
+  /// Bits of a register byte that must have a fixed value.
+  struct Bits {
+    uint8_t Byte;
+    uint8_t Mask;
+    uint8_t Val;
+  };
+  /// The number of bytes returned by a block read, or 0 if unknown.
+  uint8_t ByteCount = 0;
+  /// Reserved bits with a fixed value according to the datasheet.
+  std::vector<Bits> FixedBits;
+  /// Vendor/Device ID bytes. These carry the most weight.
+  std::vector<Bits> IDBytes;
+
+  /// The weights used for the confidence score.
+  static constexpr const unsigned ByteCountWeight = 8;
+  static constexpr const unsigned FixedBitWeight = 1;
+  static constexpr const unsigned IDBitWeight = 4;
+
+  bool empty() const {
+    return ByteCount == 0 && FixedBits.empty() && IDBytes.empty();
+  }
+  /// \Returns how well \p Block matches this signature from 0 to 100.
+  unsigned getConfidence(const std::vector<uint8_t> &Block) const;
+};
+
 class PLL : public Named {
 protected:
   /// The PLL register holding the key bits (usually 0).
@@ -147,6 +225,12 @@ protected:
   unsigned EnableI2CRegister = 0;
   /// The bit in the `EnableI2CRegister` for enabling the I2C operation.
   uint8_t EnableI2CBit = 0;
+  /// Used for auto-detecting the PLL.
+  PLLSignature Signature;
+  /// The SMBus address we talk to, SlaveAddr unless found elsewhere.
+  uint8_t Addr = SlaveAddr;
+  /// The register block as last read by getFSB().
+  mutable std::vector<uint8_t> LastBlock;
 
   /// \Returns the key value given the value of the KeyRegister.
   uint8_t getKey(uint8_t KeyRegVal) const;
@@ -156,34 +240,79 @@ protected:
   uint8_t encodeKey(uint8_t OrigKeyReg, uint8_t Key) const;
 
 public:
-  void dumpFreqTable(std::ostream &OS) const;
+  // Can be overriden for chip-specific implementations.
+  virtual void dumpFreqTable(std::ostream &OS) const;
   /// The PLL address in the SMBus according to the datasheet.
   static constexpr const uint8_t SlaveAddr = 0x69;
   /// The magic CMD we need to send according to the datasheet.
   static constexpr const uint8_t Cmd = 0x0;
+  /// Other SMBus addresses commonly used by clock generators.
+  static constexpr const uint8_t AltSlaveAddrs[] = {0x6a, 0x68};
+  /// The PLL name that triggers auto-detection.
+  static constexpr const char *AutoStr = "auto";
 
   PLL(const std::string &Name, unsigned KeyRegister,
       const std::vector<uint8_t> &KeyBits,
       const std::map<uint8_t, FreqEntry> &FreqTable, unsigned EnableI2CRegister,
-      uint8_t EnableI2CBit)
+      uint8_t EnableI2CBit, const PLLSignature &Signature = {})
       : Named(Name), KeyRegister(KeyRegister), KeyBits(KeyBits),
         FreqTable(FreqTable), EnableI2CRegister(EnableI2CRegister),
-        EnableI2CBit(EnableI2CBit) {}
+        EnableI2CBit(EnableI2CBit), Signature(Signature) {}
+  virtual ~PLL() = default;
 
   // Can be overriden for chip-specific implementations.
   virtual std::optional<FreqEntry> getFSB(SMBus &SMB) const;
 
   // Can be overriden for chip-specific implementations.
+  // \Returns the bytes to block write for \p FE, starting at byte 0 and
+  // based on the current registers, or an empty vector on error.
+  virtual std::vector<uint8_t> getFSBBlock(const FreqEntry &FE,
+                                           SMBus &SMB) const;
+
+  // Can be overriden for chip-specific implementations.
+  // Writes the getFSBBlock() bytes and sets the I2C enable bit.
   virtual bool setFSB(const FreqEntry &FE, SMBus &SMB);
 
   // Can be overriden for chip-specific implementations.
   virtual bool getEnabled(SMBus &SMB) const;
 
   // Can be overriden for chip-specific implementations.
-  virtual void setEnabled(bool NewVal, SMBus &SMB) const;
+  // Sets or clears the I2C enable bit. \Returns false on error.
+  virtual bool setEnabled(bool NewVal, SMBus &SMB) const;
+
+  /// \Returns the intermediate FreqTable entries to go through when moving
+  /// from \p From to \p To, excluding both ends. The FSB changes
+  /// monotonically along the path, the SDRAM follows the same direction and
+  /// neither SDRAM nor PCI exceed the highest value found at the two ends.
+  virtual std::vector<FreqEntry> getRampPath(const FreqEntry &From,
+                                             const FreqEntry &To) const;
+
+  /// \Returns how well the register \p Block read from the PLL matches this
+  /// PLL, from 0 to 100.
+  unsigned getConfidence(const std::vector<uint8_t> &Block) const {
+    return Signature.getConfidence(Block);
+  }
+  bool hasSignature() const { return !Signature.empty(); }
+  uint8_t getAddr() const { return Addr; }
+  void setAddr(uint8_t NewAddr) { Addr = NewAddr; }
+  const std::vector<uint8_t> &getLastBlock() const { return LastBlock; }
+  /// \Returns the FreqTable entry that setFSB() would pick for \p FE, or
+  /// nullopt if there is none.
+  std::optional<FreqEntry> findFreq(const FreqEntry &FE) const {
+    if (std::optional<uint8_t> Key = lookupKey(FE))
+      return FreqTable.at(*Key);
+    return std::nullopt;
+  }
+  /// \Returns the entries of the FreqTable.
+  std::vector<FreqEntry> getFrequencies() const {
+    std::vector<FreqEntry> Freqs;
+    for (const auto &[Key, FE] : FreqTable)
+      Freqs.push_back(FE);
+    return Freqs;
+  }
 
   // Check the PLL with a quick write.
-  bool check(HostToPCIBridge &HB) const;
+  bool check(SMBus &SMB) const;
 
   friend std::ostream &operator<<(std::ostream &OS, const PLL &P) {
     OS << P.getName();
@@ -191,8 +320,99 @@ public:
   }
 };
 
+/// A bit-field in the PLL register block.
+struct RegField {
+  /// The byte index in the block.
+  uint8_t Byte;
+  /// The lowest bit of the field within the byte.
+  uint8_t LSB;
+  /// The number of bits.
+  uint8_t Width;
+};
+/// A value spread across several fields, the least significant one first.
+using MultiRegField = std::vector<RegField>;
+
+/// A PLL with a programmable VCO, with its output given by:
+///   FSB = RefClock * N / M / PostDiv
+/// The key bits still select a FreqTable entry, but it is only used for the
+/// FSB:SDRAM:PCI ratios, while the FSB itself comes from the M/N dividers.
+/// No part is registered yet, each one's register layout, reference clock and
+/// VCO range must be checked against its datasheet first. -mnpll-check runs
+/// the solver against a reference model.
+class MNPLL : public PLL {
+public:
+  struct Divider {
+    MultiRegField Field;
+    unsigned Min;
+    unsigned Max;
+    /// The register holds `Divider - Offset`.
+    unsigned Offset = 0;
+  };
+  struct Solution {
+    unsigned M;
+    unsigned N;
+    /// The post-divider register value.
+    uint8_t PostDivRegVal;
+    float FsbMHz;
+  };
+
+private:
+  /// The reference crystal frequency in MHz (usually 14.318).
+  float RefClockMHz;
+  Divider M;
+  Divider N;
+  MultiRegField PostDivField;
+  /// Maps the post-divider register value to the actual divider.
+  std::map<uint8_t, unsigned> PostDivs;
+  /// The VCO operating range in MHz.
+  float VCOMinMHz;
+  float VCOMaxMHz;
+  /// The bit that switches the output from the key table to the M/N dividers.
+  RegField MNEnableBit;
+  /// The FSB step used when ramping.
+  static constexpr const float RampStepMHz = 5.0;
+
+  static unsigned getField(const std::vector<uint8_t> &Block,
+                           const MultiRegField &Field);
+  static void setField(std::vector<uint8_t> &Block, const MultiRegField &Field,
+                       unsigned Val);
+  /// \Returns the number of register bytes we need to read/write.
+  unsigned getBlockSize() const;
+  /// \Returns the FreqTable key with the SDRAM and PCI ratios closest to
+  /// \p FE.
+  uint8_t lookupRatioKey(const FreqEntry &FE) const;
+
+public:
+  MNPLL(const std::string &Name, unsigned KeyRegister,
+        const std::vector<uint8_t> &KeyBits,
+        const std::map<uint8_t, FreqEntry> &RatioTable,
+        unsigned EnableI2CRegister, uint8_t EnableI2CBit, float RefClockMHz,
+        const Divider &M, const Divider &N, const MultiRegField &PostDivField,
+        const std::map<uint8_t, unsigned> &PostDivs, float VCOMinMHz,
+        float VCOMaxMHz, const RegField &MNEnableBit,
+        const PLLSignature &Signature = {})
+      : PLL(Name, KeyRegister, KeyBits, RatioTable, EnableI2CRegister,
+            EnableI2CBit, Signature),
+        RefClockMHz(RefClockMHz), M(M), N(N), PostDivField(PostDivField),
+        PostDivs(PostDivs), VCOMinMHz(VCOMinMHz), VCOMaxMHz(VCOMaxMHz),
+        MNEnableBit(MNEnableBit) {}
+
+  /// Finds the M/N/PostDiv combination within the VCO limits that gets
+  /// closest to \p FsbMHz.
+  std::optional<Solution> solve(float FsbMHz) const;
+  /// \Returns the FSB range that the dividers can produce.
+  std::pair<float, float> getFsbRange() const;
+
+  void dumpFreqTable(std::ostream &OS) const override;
+  std::optional<FreqEntry> getFSB(SMBus &SMB) const override;
+  std::vector<uint8_t> getFSBBlock(const FreqEntry &FE,
+                                   SMBus &SMB) const override;
+  std::vector<FreqEntry> getRampPath(const FreqEntry &From,
+                                     const FreqEntry &To) const override;
+};
+
 class Chips {
-  std::vector<PLL> PLLs;
+  std::vector<std::unique_ptr<PLL>> PLLs;
 
   /// The Host-to-pci Bridge chips we support.
   std::vector<std::unique_ptr<HostToPCIBridge>> HostBridges;
@@ -208,6 +428,9 @@ public:
   /// Searches for any of the registered host bridges. \Returns null if not
   /// found.
   HostToPCIBridge *findHostBridge() const;
+  /// \Returns the registered host bridge named \p Name without probing the
+  /// hardware, or null if not found.
+  HostToPCIBridge *getHostBridge(const std::string &Name) const;
 
   /// Use the HostBridge \p HB to look if PLL with name \p PLLName exists.
   PLL *findPLL(const std::string &PLLName);
@@ -215,8 +438,14 @@ public:
   /// \Returns true if we support a PLL named \p PLLName.
   bool supportPLL(const std::string &PLLName);
 
+  /// Block-reads the clock generator addresses and \Returns the registered
+  /// PLL whose signature matches best, with its address set to where it was
+  /// found, or null if none is a confident match.
+  PLL *detectPLL(SMBus &SMB);
+
   /// Lists all supported PLLs.
   void listSupportedPLLs(std::ostream &OS) const;
+  const std::vector<std::unique_ptr<PLL>> &getPLLs() const { return PLLs; }
 };
 
 #endif // __SRC_CHIPS_H__
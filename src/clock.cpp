@@ -0,0 +1,71 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "clock.h"
+#include "utils.h"
+
+#ifdef LINUX
+#include <chrono>
+#else
+#include <time.h>
+#endif
+
+ClockSource &ClockSource::get() {
+  if (!Active)
+    Active = std::make_unique<SystemClock>();
+  return *Active;
+}
+
+void ClockSource::install(std::unique_ptr<ClockSource> CS) {
+  uint64_t Now = get().getMicros();
+  CS->OffsetMicros = 0;
+  CS->OffsetMicros = Now - CS->readMicros();
+  Active = std::move(CS);
+}
+
+uint64_t SystemClock::readMicros() {
+#ifdef LINUX
+  auto Now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(Now).count();
+#else
+  return (uint64_t)uclock() * 1000000 / UCLOCKS_PER_SEC;
+#endif
+}
+
+const char *SystemClock::getName() const {
+#ifdef LINUX
+  return "monotonic clock";
+#else
+  return "PIT";
+#endif
+}
+
+// The timer is read directly and not through PortIO: the busy loops would
+// flood the counters of -timing, and a replay could not serve them anyway.
+
+std::unique_ptr<ACPIPMTimer> ACPIPMTimer::probe(uint16_t Port) {
+  uint32_t First = inportl(Port);
+  uint64_t Start = ClockSource::get().getMicros();
+  uint32_t Val = First;
+  while (Val == First && ClockSource::get().getMicros() - Start < ProbeMicros)
+    Val = inportl(Port);
+  // Not there, or not enabled.
+  if (Val == First || Val == 0xffffffff)
+    return nullptr;
+  uint32_t Mask = (Val & 0xff000000) ? 0xffffffff : 0x00ffffff;
+  return std::unique_ptr<ACPIPMTimer>(new ACPIPMTimer(Port, Mask, Val & Mask));
+}
+
+uint64_t ACPIPMTimer::readMicros() {
+  uint32_t Now = inportl(Port) & Mask;
+  Ticks += (Now - Last) & Mask;
+  Last = Now;
+  return Ticks * 1000000 / Hz;
+}
+
+const char *ACPIPMTimer::getName() const {
+  return Mask == 0xffffffff ? "ACPI PM timer (32-bit)"
+                            : "ACPI PM timer (24-bit)";
+}
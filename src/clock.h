@@ -0,0 +1,79 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// The clock behind getMicros(), getMillis() and delay(). The best one is the
+// chipset's ACPI PM timer, which runs at 3.579545MHz from its own crystal, so
+// delays and rate measurements stay right while the FSB changes under them.
+// Until the host bridge tells us where it is, we use the PIT under DOS and
+// the monotonic clock on Linux.
+//
+
+#ifndef __SRC_CLOCK_H__
+#define __SRC_CLOCK_H__
+
+#include <cstdint>
+#include <memory>
+
+class ClockSource {
+  static inline std::unique_ptr<ClockSource> Active;
+  /// Added to readMicros(), so that the time does not jump on install().
+  uint64_t OffsetMicros = 0;
+
+protected:
+  /// \Returns the microseconds since an arbitrary point.
+  virtual uint64_t readMicros() = 0;
+
+public:
+  virtual ~ClockSource() = default;
+  virtual const char *getName() const = 0;
+  uint64_t getMicros() { return readMicros() + OffsetMicros; }
+
+  /// \Returns the clock in use, the default one if none was installed.
+  static ClockSource &get();
+  /// Uses \p CS from now on, continuing from the current time.
+  static void install(std::unique_ptr<ClockSource> CS);
+};
+
+/// The PIT through DJGPP's uclock() under DOS, the monotonic clock on Linux.
+/// Neither depends on the FSB.
+class SystemClock final : public ClockSource {
+protected:
+  uint64_t readMicros() override;
+
+public:
+  const char *getName() const override;
+};
+
+/// The ACPI power management timer, a free running 24-bit (or 32-bit)
+/// counter at PM1 base + 8 in the ACPI I/O space.
+class ACPIPMTimer final : public ClockSource {
+  uint16_t Port;
+  uint32_t Mask;
+  uint32_t Last;
+  /// The ticks counted so far. readMicros() has to be called at least once
+  /// per wraparound (4.7s for 24 bits) to keep it right.
+  uint64_t Ticks = 0;
+
+  ACPIPMTimer(uint16_t Port, uint32_t Mask, uint32_t Last)
+      : Port(Port), Mask(Mask), Last(Last) {}
+
+protected:
+  uint64_t readMicros() override;
+
+public:
+  static constexpr const uint32_t Hz = 3579545;
+  /// The offset of PM_TMR from the ACPI I/O base.
+  static constexpr const uint16_t Offset = 0x08;
+  /// How long probe() waits for the timer to tick.
+  static constexpr const unsigned ProbeMicros = 2000;
+
+  /// \Returns the timer at \p Port if it is counting, nullptr if not. Tells a
+  /// 32-bit timer from a 24-bit one by the top byte.
+  static std::unique_ptr<ACPIPMTimer> probe(uint16_t Port);
+  const char *getName() const override;
+  uint16_t getPort() const { return Port; }
+  unsigned getBits() const { return Mask == 0xffffffff ? 32 : 24; }
+};
+
+#endif // __SRC_CLOCK_H__
@@ -0,0 +1,49 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "cpu.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+std::optional<CPUIDRegs> CPU::cpuid(uint32_t Leaf) {
+#if defined(__i386__) || defined(__x86_64__)
+  CPUIDRegs Regs;
+  // This checks both that CPUID exists and that the leaf is supported.
+  if (!__get_cpuid(Leaf, &Regs.EAX, &Regs.EBX, &Regs.ECX, &Regs.EDX))
+    return std::nullopt;
+  return Regs;
+#else
+  return std::nullopt;
+#endif
+}
+
+bool CPU::hasFeatures(uint32_t Mask) {
+  auto Regs = cpuid(1);
+  return Regs && (Regs->EDX & Mask) == Mask;
+}
+
+bool CPU::hasInvariantTSC() {
+  auto Regs = cpuid(0x80000007);
+  return Regs && (Regs->EDX & (1u << 8));
+}
+
+uint64_t CPU::rdtsc() {
+#if defined(__i386__) || defined(__x86_64__)
+  uint32_t Lo, Hi;
+  asm volatile("rdtsc" : "=a"(Lo), "=d"(Hi));
+  return (uint64_t)Hi << 32 | Lo;
+#else
+  return 0;
+#endif
+}
+
+unsigned CPU::getPhysAddrBits() {
+  if (auto Regs = cpuid(0x80000008))
+    return Regs->EAX & 0xff;
+  // The P6 family default.
+  return 36;
+}
@@ -0,0 +1,44 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// CPU identification.
+//
+
+#ifndef __SRC_CPU_H__
+#define __SRC_CPU_H__
+
+#include <cstdint>
+#include <optional>
+
+struct CPUIDRegs {
+  uint32_t EAX = 0;
+  uint32_t EBX = 0;
+  uint32_t ECX = 0;
+  uint32_t EDX = 0;
+};
+
+class CPU {
+public:
+  /// CPUID leaf 1 EDX feature bits.
+  static constexpr const uint32_t FPUMask = 1u << 0;
+  static constexpr const uint32_t TSCMask = 1u << 4;
+  static constexpr const uint32_t MSRMask = 1u << 5;
+  static constexpr const uint32_t MTRRMask = 1u << 12;
+  static constexpr const uint32_t MMXMask = 1u << 23;
+  static constexpr const uint32_t SSEMask = 1u << 25;
+
+  /// \Returns the result of CPUID \p Leaf, or nullopt if CPUID or the leaf
+  /// is not supported (e.g. on a 486).
+  static std::optional<CPUIDRegs> cpuid(uint32_t Leaf);
+  /// \Returns true if CPUID leaf 1 reports all the \p Mask bits in EDX.
+  static bool hasFeatures(uint32_t Mask);
+  /// \Returns true if the TSC runs at a constant rate whatever the core clock.
+  static bool hasInvariantTSC();
+  /// \Returns the time stamp counter. Check TSCMask first.
+  static uint64_t rdtsc();
+  /// \Returns the number of physical address bits.
+  static unsigned getPhysAddrBits();
+};
+
+#endif // __SRC_CPU_H__
@@ -0,0 +1,15 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "dram.h"
+
+std::optional<unsigned> DRAMTimingField::read(const BDF &BDFAddr) const {
+  uint8_t Mask = (1u << Width) - 1;
+  uint8_t Raw = (PCI::readByte(BDFAddr, Reg) >> LSB) & Mask;
+  auto It = Values.find(Raw);
+  if (It == Values.end())
+    return std::nullopt;
+  return It->second;
+}
@@ -0,0 +1,45 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// SDRAM timing registers in the host bridge configuration space.
+//
+
+#ifndef __SRC_DRAM_H__
+#define __SRC_DRAM_H__
+
+#include "pci.h"
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <vector>
+
+/// A DRAM timing field in the PCI configuration space of the host bridge.
+/// These are only read, sisfsb does not change the DRAM timings.
+struct DRAMTimingField {
+  enum class Kind {
+    /// CAS latency in clocks.
+    CASLatency,
+    /// RAS-to-CAS delay in clocks.
+    RASToCAS,
+    /// RAS precharge in clocks.
+    RASPrecharge,
+    /// Refresh period in ns.
+    Refresh,
+  };
+  const char *Name;
+  Kind Ty;
+  uint8_t Reg;
+  uint8_t LSB;
+  uint8_t Width;
+  /// Maps the raw register value to the value in clocks (or ns for Refresh).
+  std::map<uint8_t, unsigned> Values;
+
+  const char *getUnit() const { return Ty == Kind::Refresh ? "ns" : "T"; }
+  /// Reads the field from \p BDFAddr. \Returns nullopt if the raw value is
+  /// not in `Values`.
+  std::optional<unsigned> read(const BDF &BDFAddr) const;
+};
+
+#endif // __SRC_DRAM_H__
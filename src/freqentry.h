@@ -53,6 +53,13 @@ public:
     return Bad == Other.Bad && Eq(Fsb, Other.Fsb, Err) &&
            Eq(Sdram, Other.Sdram, Err) && Eq(Pci, Other.Pci, Err);
   }
+  /// \Returns true if the frequencies match to 0.1MHz. operator==() allows
+  /// 2MHz, which can't tell apart table entries like 95.2, 96.2 and 97.0.
+  bool isExactly(const FreqEntry &Other) const {
+    static constexpr const float Err = 0.05;
+    return Bad == Other.Bad && Eq(Fsb, Other.Fsb, Err) &&
+           Eq(Sdram, Other.Sdram, Err) && Eq(Pci, Other.Pci, Err);
+  }
 };
 
 #endif // __SRC_FREQENTRY_H__
@@ -0,0 +1,265 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Build step: turns pci.ids into the perfect hash tables of pciids.cpp.
+// Usage: genpciids <pci.ids> <output.inc>
+//
+
+#include "pciids.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct KeyName {
+  uint32_t Key;
+  std::string Name;
+};
+
+/// The names packed into one blob, sharing identical strings and suffixes.
+class StringBlob {
+  std::string Blob;
+  std::map<std::string, uint32_t> Offsets;
+
+public:
+  /// Adds all of \p Names, longest first so that the shorter ones can reuse
+  /// their tails.
+  void add(std::vector<std::string> Names) {
+    std::sort(Names.begin(), Names.end(),
+              [](const std::string &A, const std::string &B) {
+                return A.size() != B.size() ? A.size() > B.size() : A < B;
+              });
+    for (const std::string &Name : Names) {
+      if (Offsets.count(Name))
+        continue;
+      std::string::size_type Pos = Blob.find(Name + '\0');
+      if (Pos == std::string::npos) {
+        Pos = Blob.size();
+        Blob += Name + '\0';
+      }
+      Offsets[Name] = Pos;
+    }
+  }
+  uint32_t getOffset(const std::string &Name) const {
+    return Offsets.at(Name);
+  }
+  const std::string &get() const { return Blob; }
+};
+
+struct PerfectHash {
+  std::vector<uint16_t> Seeds;
+  std::vector<PCIIDs::Entry> Slots;
+};
+
+/// Hash and displace: the keys are split into buckets, and each bucket (the
+/// biggest first) gets the first seed that puts all of its keys into free
+/// slots. \Returns false if some bucket has no such seed.
+static bool buildHash(const std::vector<KeyName> &Keys, const StringBlob &SB,
+                      uint32_t NumSlots, PerfectHash &PH) {
+  uint32_t NumBuckets = Keys.size() / 2 + 1;
+  std::vector<std::vector<const KeyName *>> Buckets(NumBuckets);
+  for (const KeyName &KN : Keys)
+    Buckets[PCIIDs::hash(KN.Key, 0) % NumBuckets].push_back(&KN);
+  std::vector<uint32_t> Order(NumBuckets);
+  for (uint32_t Idx = 0; Idx != NumBuckets; ++Idx)
+    Order[Idx] = Idx;
+  std::stable_sort(Order.begin(), Order.end(), [&](uint32_t A, uint32_t B) {
+    return Buckets[A].size() > Buckets[B].size();
+  });
+
+  PH.Seeds.assign(NumBuckets, 0);
+  PH.Slots.assign(NumSlots, {PCIIDs::EmptyKey, 0});
+  for (uint32_t BIdx : Order) {
+    const auto &Bucket = Buckets[BIdx];
+    if (Bucket.empty())
+      break;
+    bool Placed = false;
+    for (uint32_t Seed = 1; Seed <= 0xffff && !Placed; ++Seed) {
+      std::vector<uint32_t> Taken;
+      for (const KeyName *KN : Bucket) {
+        uint32_t Slot = PCIIDs::hash(KN->Key, Seed) % NumSlots;
+        if (PH.Slots[Slot].Key != PCIIDs::EmptyKey ||
+            std::find(Taken.begin(), Taken.end(), Slot) != Taken.end())
+          break;
+        Taken.push_back(Slot);
+      }
+      if (Taken.size() != Bucket.size())
+        continue;
+      for (size_t Idx = 0; Idx != Bucket.size(); ++Idx)
+        PH.Slots[Taken[Idx]] = {Bucket[Idx]->Key,
+                                (uint16_t)SB.getOffset(Bucket[Idx]->Name)};
+      PH.Seeds[BIdx] = Seed;
+      Placed = true;
+    }
+    if (!Placed)
+      return false;
+  }
+  return true;
+}
+
+static bool buildHash(const std::vector<KeyName> &Keys, const StringBlob &SB,
+                      PerfectHash &PH) {
+  // Start at ~90% load and make room until it works.
+  for (uint32_t NumSlots = Keys.size() + Keys.size() / 8 + 1;
+       NumSlots < 4 * Keys.size() + 16; NumSlots += NumSlots / 16 + 1)
+    if (buildHash(Keys, SB, NumSlots, PH))
+      return true;
+  return false;
+}
+
+/// \Returns the hex number at the start of \p Str, which must be exactly
+/// \p Digits long and followed by whitespace.
+static bool parseHex(const std::string &Str, unsigned Digits, uint32_t &Val) {
+  if (Str.size() <= Digits || !std::isspace((unsigned char)Str[Digits]))
+    return false;
+  for (unsigned Idx = 0; Idx != Digits; ++Idx)
+    if (!std::isxdigit((unsigned char)Str[Idx]))
+      return false;
+  Val = std::strtoul(Str.substr(0, Digits).c_str(), nullptr, 16);
+  return true;
+}
+
+static std::string getName(const std::string &Str, unsigned Digits) {
+  std::string::size_type Start = Str.find_first_not_of(" \t", Digits);
+  std::string::size_type End = Str.find_last_not_of(" \t\r");
+  if (Start == std::string::npos)
+    return "";
+  return Str.substr(Start, End - Start + 1);
+}
+
+static void writeTable(std::ostream &OS, const char *Name,
+                       const PerfectHash &PH) {
+  OS << "static const uint16_t " << Name << "Seeds[] = {";
+  for (size_t Idx = 0; Idx != PH.Seeds.size(); ++Idx)
+    OS << (Idx % 12 == 0 ? "\n   " : "") << " " << PH.Seeds[Idx] << ",";
+  OS << "\n};\n";
+  OS << "static const PCIIDs::Entry " << Name << "Slots[] = {";
+  char Buf[32];
+  for (size_t Idx = 0; Idx != PH.Slots.size(); ++Idx) {
+    std::snprintf(Buf, sizeof(Buf), "{0x%08x, %u},",
+                  (unsigned)PH.Slots[Idx].Key, PH.Slots[Idx].NameOff);
+    OS << (Idx % 3 == 0 ? "\n   " : "") << " " << Buf;
+  }
+  OS << "\n};\n";
+}
+
+int main(int Argc, char **Argv) {
+  if (Argc != 3) {
+    std::cerr << "Usage: " << Argv[0] << " <pci.ids> <output.inc>"
+              << std::endl;
+    return 1;
+  }
+  std::ifstream IS(Argv[1]);
+  if (!IS) {
+    std::cerr << "Failed to open " << Argv[1] << std::endl;
+    return 1;
+  }
+  std::vector<KeyName> IDs;
+  std::vector<KeyName> Classes;
+  // The line of each key, per table, since the class and ID keys overlap.
+  std::map<std::pair<bool, uint32_t>, unsigned> Seen;
+  // The enclosing vendor or class.
+  uint32_t Parent = 0;
+  bool InClasses = false;
+  std::string Line;
+  for (unsigned LineNo = 1; std::getline(IS, Line); ++LineNo) {
+    if (Line.empty() || Line[0] == '#' || Line.find_first_not_of(" \t\r") ==
+                                              std::string::npos)
+      continue;
+    uint32_t Val;
+    std::vector<KeyName> *Dst = nullptr;
+    KeyName KN;
+    if (Line.compare(0, 2, "C ") == 0 && parseHex(Line.substr(2), 2, Val)) {
+      InClasses = true;
+      Parent = Val;
+      KN = {PCIIDs::ClassOnlyMask | Val << 8, getName(Line, 4)};
+      Dst = &Classes;
+    } else if (Line[0] != '\t' && parseHex(Line, 4, Val)) {
+      InClasses = false;
+      Parent = Val;
+      KN = {Val, getName(Line, 4)};
+      Dst = &IDs;
+    } else if (Line[0] == '\t' && Line[1] != '\t') {
+      std::string Rest = Line.substr(1);
+      if (InClasses && parseHex(Rest, 2, Val)) {
+        KN = {Parent << 8 | Val, getName(Rest, 2)};
+        Dst = &Classes;
+      } else if (!InClasses && parseHex(Rest, 4, Val)) {
+        KN = {PCIIDs::getDeviceKey(Parent, Val), getName(Rest, 4)};
+        Dst = &IDs;
+      }
+    } else if (Line[0] == '\t') {
+      // Subsystems and programming interfaces, we don't list those.
+      continue;
+    }
+    if (Dst == nullptr || KN.Name.empty()) {
+      std::cerr << Argv[1] << ":" << LineNo << ": can't parse: " << Line
+                << std::endl;
+      return 1;
+    }
+    auto SeenKey = std::make_pair(Dst == &Classes, KN.Key);
+    if (Seen.count(SeenKey)) {
+      std::cerr << Argv[1] << ":" << LineNo << ": duplicate of line "
+                << Seen[SeenKey] << std::endl;
+      return 1;
+    }
+    Seen[SeenKey] = LineNo;
+    Dst->push_back(KN);
+  }
+
+  StringBlob SB;
+  std::vector<std::string> Names;
+  for (const auto *Keys : {&IDs, &Classes})
+    for (const KeyName &KN : *Keys)
+      Names.push_back(KN.Name);
+  SB.add(Names);
+  if (SB.get().size() > 0xffff) {
+    std::cerr << "The names take " << SB.get().size()
+              << " bytes, more than the 64KB we can address. Use a smaller "
+                 "subset of pci.ids."
+              << std::endl;
+    return 1;
+  }
+  PerfectHash IDHash, ClassHash;
+  if (!buildHash(IDs, SB, IDHash) || !buildHash(Classes, SB, ClassHash)) {
+    std::cerr << "Failed to build a perfect hash" << std::endl;
+    return 1;
+  }
+
+  std::ofstream OS(Argv[2]);
+  OS << "// Generated by genpciids from " << Argv[1] << ", do not edit.\n";
+  OS << "// " << IDs.size() << " vendors and devices, " << Classes.size()
+     << " classes, " << SB.get().size() << " bytes of names.\n";
+  OS << "static const uint32_t NumIDs = " << IDs.size() << ";\n";
+  OS << "static const uint32_t NumClasses = " << Classes.size() << ";\n";
+  OS << "static const char Names[] =";
+  // One literal per name, so that a "\0" is never followed by a digit.
+  const std::string &Blob = SB.get();
+  std::string::size_type Start = 0;
+  while (Start < Blob.size()) {
+    std::string::size_type End = Blob.find('\0', Start);
+    OS << "\n    \"";
+    for (char C : Blob.substr(Start, End - Start)) {
+      if (C == '"' || C == '\\' || C == '?')
+        OS << '\\';
+      OS << C;
+    }
+    OS << "\\0\"";
+    Start = End + 1;
+  }
+  OS << ";\n";
+  writeTable(OS, "ID", IDHash);
+  writeTable(OS, "Class", ClassHash);
+  if (!OS) {
+    std::cerr << "Failed to write " << Argv[2] << std::endl;
+    return 1;
+  }
+  return 0;
+}
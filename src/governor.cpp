@@ -0,0 +1,221 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "governor.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+std::optional<GovernorConfig> GovernorConfig::parse(const std::string &Str) {
+  GovernorConfig Cfg;
+  std::string::size_type Start = 0;
+  while (Start < Str.size()) {
+    std::string::size_type End = Str.find(',', Start);
+    if (End == std::string::npos)
+      End = Str.size();
+    std::string Setting = Str.substr(Start, End - Start);
+    Start = End + 1;
+    std::string::size_type Eq = Setting.find('=');
+    if (Eq == std::string::npos || Eq == 0 || Eq + 1 == Setting.size()) {
+      std::cerr << "Bad governor setting '" << Setting
+                << "', expected <name>=<value>" << std::endl;
+      return std::nullopt;
+    }
+    std::string Name = toLower(Setting.substr(0, Eq));
+    std::string Val = Setting.substr(Eq + 1);
+    unsigned Num = std::strtoul(Val.c_str(), nullptr, 10);
+    if (Name == "fast")
+      Cfg.Fast = FreqEntry(Val);
+    else if (Name == "cool")
+      Cfg.Cool = FreqEntry(Val);
+    else if (Name == "up")
+      Cfg.UpPercent = Num;
+    else if (Name == "down")
+      Cfg.DownPercent = Num;
+    else if (Name == "temp")
+      Cfg.MaxTempC = Num;
+    else if (Name == "interval")
+      Cfg.IntervalMillis = Num;
+    else if (Name == "dwell")
+      Cfg.DwellMillis = Num;
+    else if (Name == "writes")
+      Cfg.MaxWritesPerHour = Num;
+    else if (Name == "samples")
+      Cfg.Samples = Num;
+    else if (Name == "stat")
+      Cfg.StatFile = Val;
+    else {
+      std::cerr << "Unknown governor setting '" << Name << "'" << std::endl;
+      return std::nullopt;
+    }
+  }
+  if (Cfg.Fast.bad() || Cfg.Cool.bad()) {
+    std::cerr << "The governor needs fast=<FSB/SDRAM/PCI> and "
+                 "cool=<FSB/SDRAM/PCI>"
+              << std::endl;
+    return std::nullopt;
+  }
+  if (Cfg.DownPercent >= Cfg.UpPercent || Cfg.UpPercent > 100) {
+    std::cerr << "Need down < up <= 100" << std::endl;
+    return std::nullopt;
+  }
+  if (Cfg.IntervalMillis == 0 || Cfg.MaxWritesPerHour == 0) {
+    std::cerr << "The interval and writes must be non-zero" << std::endl;
+    return std::nullopt;
+  }
+  return Cfg;
+}
+
+void GovernorConfig::print(std::ostream &OS) const {
+  DecimalGuard DG(OS);
+  OS << "Governor: fast " << Fast << " at load >= " << UpPercent
+     << "%, cool " << Cool << " at load <= " << DownPercent << "%";
+  if (MaxTempC != 0)
+    OS << " or temp >= " << MaxTempC << "C";
+  OS << ", every " << IntervalMillis << "ms, dwell " << DwellMillis
+     << "ms, max " << MaxWritesPerHour << " writes/hour";
+}
+
+std::optional<unsigned> CPULoad::sample() {
+  std::ifstream File(StatFile);
+  std::string Line;
+  if (!File || !std::getline(File, Line) || Line.compare(0, 4, "cpu ") != 0) {
+    std::cerr << "Failed to read the cpu line of " << StatFile << std::endl;
+    return std::nullopt;
+  }
+  // cpu user nice system idle iowait irq softirq steal ...
+  std::istringstream SS(Line.substr(4));
+  uint64_t Total = 0;
+  uint64_t Idle = 0;
+  uint64_t Val;
+  for (unsigned Idx = 0; SS >> Val; ++Idx) {
+    Total += Val;
+    if (Idx == 3 || Idx == 4)
+      Idle += Val;
+  }
+  uint64_t Busy = Total - Idle;
+  uint64_t DeltaTotal = Total - LastTotal;
+  uint64_t DeltaBusy = Busy - LastBusy;
+  // Treat a counter reset (e.g. a rewritten fake file) as a fresh start.
+  if (Total < LastTotal || Busy < LastBusy) {
+    DeltaTotal = Total;
+    DeltaBusy = Busy;
+  }
+  LastTotal = Total;
+  LastBusy = Busy;
+  if (DeltaTotal == 0)
+    return 0;
+  return (unsigned)(DeltaBusy * 100 / DeltaTotal);
+}
+
+std::optional<int> Governor::getTemp() {
+  if (!Mon)
+    return std::nullopt;
+  HWMonSample Sample;
+  if (!Mon->sample(Sample))
+    return std::nullopt;
+  return *std::max_element(Sample.Temps.begin(), Sample.Temps.end());
+}
+
+Governor::Mode Governor::decide(unsigned LoadPercent,
+                                std::optional<int> TempC) const {
+  if (Cfg.MaxTempC != 0 && TempC) {
+    if (*TempC >= Cfg.MaxTempC)
+      return Mode::Cool;
+    if (Current == Mode::Cool &&
+        *TempC > Cfg.MaxTempC - GovernorConfig::TempHysteresisC)
+      return Mode::Cool;
+  }
+  if (LoadPercent >= Cfg.UpPercent)
+    return Mode::Fast;
+  if (LoadPercent <= Cfg.DownPercent)
+    return Mode::Cool;
+  return Current;
+}
+
+bool Governor::canWrite(unsigned long NowMillis) {
+  static constexpr const unsigned long HourMillis = 60 * 60 * 1000;
+  WriteTimes.erase(std::remove_if(WriteTimes.begin(), WriteTimes.end(),
+                                  [NowMillis](unsigned long T) {
+                                    return NowMillis - T >= HourMillis;
+                                  }),
+                   WriteTimes.end());
+  return WriteTimes.size() < Cfg.MaxWritesPerHour;
+}
+
+bool Governor::run() {
+  // Catch frequencies that the PLL can't set now, not at the first switch.
+  PLL &Pll = S.getPLL();
+  for (FreqEntry *FE : {&Cfg.Fast, &Cfg.Cool}) {
+    std::optional<FreqEntry> TableFE = Pll.findFreq(*FE);
+    if (!TableFE) {
+      std::cerr << "Governor: " << *FE << " is not supported by " << Pll
+                << '\n';
+      Pll.dumpFreqTable(std::cerr);
+      return false;
+    }
+    *FE = *TableFE;
+  }
+  Cfg.print(std::cout);
+  std::cout << std::endl;
+  Mon = HWMonitor::find(S.getSMB());
+  if (Mon)
+    std::cout << "Using " << Mon->getName() << " for the temperature"
+              << std::endl;
+  else if (Cfg.MaxTempC != 0)
+    std::cout << "No hardware monitor found, ignoring temp" << std::endl;
+  // Start from whatever the PLL is set to.
+  std::optional<FreqEntry> FE = S.getFrequency();
+  if (!FE)
+    return false;
+  Current = *FE == Cfg.Fast ? Mode::Fast : Mode::Cool;
+  bool Known = *FE == Cfg.Fast || *FE == Cfg.Cool;
+  // Prime the load counters.
+  if (!Load.sample())
+    return false;
+  DecimalGuard DG(std::cout);
+  for (unsigned Cnt = 0; Cfg.Samples == 0 || Cnt != Cfg.Samples; ++Cnt) {
+    delay(Cfg.IntervalMillis);
+    std::optional<unsigned> LoadPercent = Load.sample();
+    if (!LoadPercent)
+      return false;
+    std::optional<int> TempC = getTemp();
+    Mode Want = decide(*LoadPercent, TempC);
+    std::cout << "Load " << *LoadPercent << "%";
+    if (TempC)
+      std::cout << " temp " << *TempC << "C";
+    std::cout << " " << (Current == Mode::Fast ? "fast" : "cool");
+    if (Want == Current && Known) {
+      std::cout << std::endl;
+      continue;
+    }
+    unsigned long Now = getMillis();
+    if (LastSwitchMillis && Now - *LastSwitchMillis < Cfg.DwellMillis) {
+      std::cout << " (dwell)" << std::endl;
+      continue;
+    }
+    if (!canWrite(Now)) {
+      std::cout << " (rate limited)" << std::endl;
+      continue;
+    }
+    const FreqEntry &Target = Want == Mode::Fast ? Cfg.Fast : Cfg.Cool;
+    std::cout << " -> " << (Want == Mode::Fast ? "fast " : "cool ") << Target
+              << std::endl;
+    WriteTimes.push_back(Now);
+    LastSwitchMillis = Now;
+    if (!S.setFrequency(Target))
+      return false;
+    FE = S.getFrequency();
+    if (!FE || !(*FE == Target)) {
+      std::cerr << "The PLL did not switch to " << Target << std::endl;
+      return false;
+    }
+    Current = Want;
+    Known = true;
+  }
+  return true;
+}
@@ -0,0 +1,91 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// A daemon that switches between a "fast" and a "cool" FreqTable entry based
+// on the CPU load and, if a hardware monitor is found, the temperature.
+//
+
+#ifndef __SRC_GOVERNOR_H__
+#define __SRC_GOVERNOR_H__
+
+#include "freqentry.h"
+#include "hwmon.h"
+#include "session.h"
+#include <memory>
+#include <optional>
+#include <string>
+
+struct GovernorConfig {
+  /// The frequencies used under load and when idle or hot.
+  FreqEntry Fast;
+  FreqEntry Cool;
+  /// Switch to Fast at or above this load (percent)...
+  unsigned UpPercent = 70;
+  /// ...and back to Cool at or below this one.
+  unsigned DownPercent = 30;
+  /// Switch to Cool at or above this temperature, 0 to disable. We go back
+  /// to Fast only once it drops TempHysteresisC below it.
+  int MaxTempC = 0;
+  static constexpr const int TempHysteresisC = 5;
+  /// How often we sample the load.
+  unsigned IntervalMillis = 1000;
+  /// The minimum time we stay at a frequency before switching again.
+  unsigned DwellMillis = 10000;
+  /// The maximum number of PLL writes per hour.
+  unsigned MaxWritesPerHour = 30;
+  /// Stop after this many samples, 0 for never.
+  unsigned Samples = 0;
+  /// The file with the Linux "cpu" line.
+  std::string StatFile = "/proc/stat";
+
+  /// Parses "name=value,..." with the names fast, cool, up, down, temp,
+  /// interval, dwell, writes, samples and stat. \Returns nullopt on error.
+  static std::optional<GovernorConfig> parse(const std::string &Str);
+  void print(std::ostream &OS) const;
+};
+
+/// The CPU utilization from the aggregate "cpu" line of /proc/stat.
+class CPULoad {
+  std::string StatFile;
+  uint64_t LastBusy = 0;
+  uint64_t LastTotal = 0;
+
+public:
+  CPULoad(const std::string &StatFile) : StatFile(StatFile) {}
+  /// \Returns the busy percentage since the previous call (or since boot for
+  /// the first call), or nullopt if the file can't be read.
+  std::optional<unsigned> sample();
+};
+
+class Governor {
+public:
+  enum class Mode { Fast, Cool };
+
+private:
+  Session &S;
+  GovernorConfig Cfg;
+  CPULoad Load;
+  std::unique_ptr<HWMonitor> Mon;
+  Mode Current = Mode::Cool;
+  /// When we last switched, or nullopt if we never did.
+  std::optional<unsigned long> LastSwitchMillis;
+  /// The times of the PLL writes within the last hour.
+  std::vector<unsigned long> WriteTimes;
+
+  /// \Returns the hottest temperature sensor, or nullopt if none.
+  std::optional<int> getTemp();
+  /// \Returns true if the rate limit allows a PLL write at \p NowMillis.
+  bool canWrite(unsigned long NowMillis);
+
+public:
+  Governor(Session &S, const GovernorConfig &Cfg)
+      : S(S), Cfg(Cfg), Load(Cfg.StatFile) {}
+  /// \Returns the mode we want to be in given the \p LoadPercent and
+  /// \p TempC, with hysteresis around the current mode.
+  Mode decide(unsigned LoadPercent, std::optional<int> TempC) const;
+  /// Runs the control loop. \Returns false on error.
+  bool run();
+};
+
+#endif // __SRC_GOVERNOR_H__
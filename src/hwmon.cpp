@@ -0,0 +1,212 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "hwmon.h"
+#include "smbusqueue.h"
+#include "utils.h"
+#include <algorithm>
+#include <iomanip>
+
+void HWMonSample::print(std::ostream &OS) const {
+  static constexpr const char *VoltNames[NumVolts] = {
+      "Vcore", "VcoreB", "+3.3V", "+5V", "+12V", "-12V", "-5V"};
+  DecimalGuard DG(OS);
+  OS << std::fixed << std::setprecision(2);
+  OS << std::setw(6) << TimeMillis / 1000 << "s";
+  for (unsigned Idx = 0; Idx != NumVolts; ++Idx)
+    OS << " " << VoltNames[Idx] << "=" << Volts[Idx];
+  OS << " Temp=";
+  for (unsigned Idx = 0; Idx != NumTemps; ++Idx)
+    OS << (Idx ? "/" : "") << Temps[Idx];
+  OS << "C Fan=";
+  for (unsigned Idx = 0; Idx != NumFans; ++Idx)
+    OS << (Idx ? "/" : "") << FanRPM[Idx];
+  OS << "RPM";
+}
+
+std::unique_ptr<HWMonitor> HWMonitor::find(SMBus &SMB) {
+  for (unsigned Addr = W8378xMonitor::FirstAddr;
+       Addr <= W8378xMonitor::LastAddr; ++Addr) {
+    if (!SMB.probe(Addr, /*Read=*/false))
+      continue;
+    if (auto Mon = W8378xMonitor::probe(SMB, Addr))
+      return Mon;
+  }
+  return nullptr;
+}
+
+std::unique_ptr<HWMonitor> W8378xMonitor::probe(SMBus &SMB, uint8_t Addr) {
+  auto BankSel = SMB.readByteData(Addr, BankSelReg);
+  if (!BankSel)
+    return nullptr;
+  // The vendor ID register returns the high or low byte based on HBACS.
+  uint16_t VendorID = 0;
+  for (bool High : {true, false}) {
+    uint8_t NewBankSel = High ? (*BankSel | HBACSMask) : (*BankSel & ~HBACSMask);
+    if (!SMB.writeByteData(Addr, BankSelReg, NewBankSel))
+      return nullptr;
+    auto Byte = SMB.readByteData(Addr, VendorIDReg);
+    if (!Byte)
+      return nullptr;
+    VendorID |= High ? *Byte << 8 : *Byte;
+  }
+  SMB.writeByteData(Addr, BankSelReg, *BankSel);
+  if (VendorID != WinbondVendorID)
+    return nullptr;
+  auto ChipID = SMB.readByteData(Addr, ChipIDReg);
+  if (!ChipID ||
+      (*ChipID != W83781DChipID && *ChipID != W83782DChipID))
+    return nullptr;
+  auto Mon = std::make_unique<W8378xMonitor>(SMB, Addr,
+                                             *ChipID == W83782DChipID);
+  if (!Mon->init())
+    return nullptr;
+  return Mon;
+}
+
+bool W8378xMonitor::readFanDivisors() {
+  auto Div12 = readReg(FanDiv12Reg);
+  auto Div3 = readReg(FanDiv3Reg);
+  if (!Div12 || !Div3)
+    return false;
+  std::array<unsigned, HWMonSample::NumFans> Bits = {
+      (unsigned)(*Div12 >> 4) & 0x3, (unsigned)(*Div12 >> 6) & 0x3,
+      (unsigned)(*Div3 >> 6) & 0x3};
+  if (Is782D) {
+    auto Bit2 = readReg(FanDivBit2Reg);
+    if (!Bit2)
+      return false;
+    for (unsigned Fan = 0; Fan != HWMonSample::NumFans; ++Fan)
+      if (*Bit2 & (0x20 << Fan))
+        Bits[Fan] |= 0x4;
+  }
+  for (unsigned Fan = 0; Fan != HWMonSample::NumFans; ++Fan)
+    FanDivs[Fan] = 1u << Bits[Fan];
+  return true;
+}
+
+bool W8378xMonitor::init() {
+  auto BankSelOpt = readReg(BankSelReg);
+  if (!BankSelOpt)
+    return false;
+  BankSel = *BankSelOpt & ~BankMask;
+  return readFanDivisors();
+}
+
+float W8378xMonitor::scaleVolts(unsigned Idx, uint8_t Raw) const {
+  // The resistor dividers recommended by the datasheets, as in lm_sensors.
+  float V = Raw * VoltLSB;
+  switch (Idx) {
+  case 3:
+    return V * 1.68;
+  case 4:
+    return V * 3.8;
+  case 5:
+    return Is782D ? V * 5.14 - 14.91 : V * -3.477;
+  case 6:
+    return Is782D ? V * 3.14 - 7.71 : V * -1.505;
+  default:
+    return V;
+  }
+}
+
+unsigned W8378xMonitor::getTransactionsPerSample() const {
+  // The bank 0 range plus select/read/select/read/restore for temps 2 and 3.
+  return (LastSensorReg - FirstSensorReg + 1) + 5;
+}
+
+bool W8378xMonitor::sample(HWMonSample &Sample) {
+  Sample.TimeMillis = getMillis();
+  using Op = SMBusRequest::Op;
+  // Queue all transactions so that they run back to back. The chip only
+  // supports byte transfers, so read the contiguous bank 0 range and decode
+  // it afterwards. Temperatures 2 and 3 are in banks 1 and 2, we only need
+  // the integer part.
+  SMBusQueue Q(SMB);
+  std::vector<SMBusQueue::Handle> Reads;
+  std::vector<SMBusQueue::Handle> Writes;
+  for (uint8_t Reg = FirstSensorReg; Reg <= LastSensorReg; ++Reg)
+    Reads.push_back(Q.submit({Op::ReadByteData, Addr, Reg}));
+  for (uint8_t Bank = 1; Bank <= 2; ++Bank) {
+    Writes.push_back(Q.submit(
+        {Op::WriteByteData, Addr, BankSelReg, {(uint8_t)(BankSel | Bank)}}));
+    Reads.push_back(Q.submit({Op::ReadByteData, Addr, Temp23Reg}));
+  }
+  Writes.push_back(Q.submit({Op::WriteByteData, Addr, BankSelReg, {BankSel}}));
+  Q.drain();
+
+  bool Success = true;
+  for (SMBusQueue::Handle H : Writes)
+    Success &= Q.take(H)->ok();
+  std::vector<uint8_t> Regs;
+  for (SMBusQueue::Handle H : Reads) {
+    std::optional<SMBusRequest> Req = Q.take(H);
+    Success &= Req->ok();
+    Regs.push_back(Req->ok() ? Req->Data[0] : 0);
+  }
+  if (!Success)
+    return false;
+  for (unsigned Idx = 0; Idx != HWMonSample::NumVolts; ++Idx)
+    Sample.Volts[Idx] = scaleVolts(Idx, Regs[Idx]);
+  Sample.Temps[0] = (int8_t)Regs[Temp1Reg - FirstSensorReg];
+  for (unsigned Fan = 0; Fan != HWMonSample::NumFans; ++Fan) {
+    uint8_t Count = Regs[Fan1Reg - FirstSensorReg + Fan];
+    Sample.FanRPM[Fan] =
+        (Count == 0 || Count == 0xff) ? 0 : FanClock / (Count * FanDivs[Fan]);
+  }
+  // The bank 1 and 2 temperatures follow the bank 0 range.
+  const unsigned NumBank0 = LastSensorReg - FirstSensorReg + 1;
+  Sample.Temps[1] = (int8_t)Regs[NumBank0];
+  Sample.Temps[2] = (int8_t)Regs[NumBank0 + 1];
+  return true;
+}
+
+bool HWMonSampler::sample() {
+  HWMonSample Sample;
+  if (!Mon.sample(Sample))
+    return false;
+  History.push(Sample);
+  return true;
+}
+
+void HWMonSampler::printLast(std::ostream &OS) const {
+  if (History.empty())
+    return;
+  OS << History.back();
+  // Peaks within the history window.
+  int MaxTemp = History[0].Temps[0];
+  float MinVcore = History[0].Volts[0];
+  float MaxVcore = MinVcore;
+  for (std::size_t Idx = 0, E = History.size(); Idx != E; ++Idx) {
+    const HWMonSample &S = History[Idx];
+    MaxTemp = std::max(MaxTemp, *std::max_element(S.Temps.begin(), S.Temps.end()));
+    MinVcore = std::min(MinVcore, S.Volts[0]);
+    MaxVcore = std::max(MaxVcore, S.Volts[0]);
+  }
+  DecimalGuard DG(OS);
+  OS << std::fixed << std::setprecision(2) << " | Peak Temp=" << MaxTemp
+     << "C Vcore=" << MinVcore << "-" << MaxVcore << std::endl;
+}
+
+bool HWMonSampler::run(unsigned IntervalMillis, unsigned Count) {
+  {
+    DecimalGuard DG(std::cout);
+    std::cout << "Monitoring " << Mon.getName() << " every " << IntervalMillis
+              << "ms (" << Mon.getTransactionsPerSample()
+              << " SMBus transactions per sample)" << std::endl;
+  }
+  for (unsigned Cnt = 0; Count == 0 || Cnt != Count; ++Cnt) {
+    unsigned long Start = getMillis();
+    if (!sample()) {
+      std::cerr << "Failed to sample " << Mon.getName() << std::endl;
+      return false;
+    }
+    printLast(std::cout);
+    unsigned long Elapsed = getMillis() - Start;
+    if (Elapsed < IntervalMillis)
+      delay(IntervalMillis - Elapsed);
+  }
+  return true;
+}
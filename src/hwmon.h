@@ -0,0 +1,148 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Hardware monitor chips (temperatures, fans, voltages) on the SMBus.
+//
+
+#ifndef __SRC_HWMON_H__
+#define __SRC_HWMON_H__
+
+#include "ringbuffer.h"
+#include "smbus.h"
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/// A single reading of all sensors.
+struct HWMonSample {
+  static constexpr const unsigned NumVolts = 7;
+  static constexpr const unsigned NumTemps = 3;
+  static constexpr const unsigned NumFans = 3;
+  /// When the sample was taken, from getMillis().
+  unsigned long TimeMillis = 0;
+  /// Vcore, Vcore B, +3.3V, +5V, +12V, -12V, -5V.
+  std::array<float, NumVolts> Volts = {};
+  /// In degrees Celsius.
+  std::array<int, NumTemps> Temps = {};
+  /// 0 if stalled or not connected.
+  std::array<unsigned, NumFans> FanRPM = {};
+
+  void print(std::ostream &OS) const;
+  friend std::ostream &operator<<(std::ostream &OS, const HWMonSample &S) {
+    S.print(OS);
+    return OS;
+  }
+};
+
+/// The interface of the hardware monitor drivers.
+class HWMonitor {
+protected:
+  std::string Name;
+  SMBus &SMB;
+  uint8_t Addr;
+
+  HWMonitor(const std::string &Name, SMBus &SMB, uint8_t Addr)
+      : Name(Name), SMB(SMB), Addr(Addr) {}
+
+public:
+  virtual ~HWMonitor() = default;
+  const std::string &getName() const { return Name; }
+  uint8_t getAddr() const { return Addr; }
+  /// Reads the sensors into \p Sample. \Returns false on error.
+  virtual bool sample(HWMonSample &Sample) = 0;
+  /// \Returns the number of SMBus transactions each sample() costs.
+  virtual unsigned getTransactionsPerSample() const = 0;
+
+  /// Looks for a supported monitor chip on \p SMB. \Returns null if none.
+  static std::unique_ptr<HWMonitor> find(SMBus &SMB);
+};
+
+/// Winbond W83781D/W83782D and compatible chips.
+class W8378xMonitor final : public HWMonitor {
+public:
+  /// The serial bus address range of the chip (default 0x2d).
+  static constexpr const uint8_t FirstAddr = 0x28;
+  static constexpr const uint8_t LastAddr = 0x2f;
+
+private:
+  /// Bank 0 holds the voltages, temperature 1 and the fan counts in one
+  /// contiguous range.
+  static constexpr const uint8_t FirstSensorReg = 0x20;
+  static constexpr const uint8_t LastSensorReg = 0x2a;
+  static constexpr const uint8_t Temp1Reg = 0x27;
+  static constexpr const uint8_t Fan1Reg = 0x28;
+  static constexpr const uint8_t FanDiv12Reg = 0x47;
+  static constexpr const uint8_t FanDiv3Reg = 0x4b;
+  static constexpr const uint8_t BankSelReg = 0x4e;
+  static constexpr const uint8_t VendorIDReg = 0x4f;
+  /// In banks 1 and 2.
+  static constexpr const uint8_t Temp23Reg = 0x50;
+  static constexpr const uint8_t ChipIDReg = 0x58;
+  /// W83782D only: bit 2 of the fan divisors.
+  static constexpr const uint8_t FanDivBit2Reg = 0x5d;
+
+  /// Selects the high byte of the vendor ID in VendorIDReg.
+  static constexpr const uint8_t HBACSMask = 0x80;
+  static constexpr const uint8_t BankMask = 0x07;
+  static constexpr const uint16_t WinbondVendorID = 0x5ca3;
+  static constexpr const uint8_t W83781DChipID = 0x10;
+  static constexpr const uint8_t W83782DChipID = 0x30;
+
+  /// 16mV per LSB.
+  static constexpr const float VoltLSB = 0.016;
+  /// Fan RPM = FanClock / (Count * Divisor).
+  static constexpr const unsigned FanClock = 1350000;
+
+  bool Is782D;
+  /// The original bank select value, which we restore after each sample.
+  uint8_t BankSel = 0;
+  /// The fan divisors don't change between samples, so read them once.
+  std::array<unsigned, HWMonSample::NumFans> FanDivs = {2, 2, 2};
+
+  std::optional<uint8_t> readReg(uint8_t Reg) {
+    return SMB.readByteData(Addr, Reg);
+  }
+  bool writeReg(uint8_t Reg, uint8_t Val) {
+    return SMB.writeByteData(Addr, Reg, Val);
+  }
+  bool readFanDivisors();
+  float scaleVolts(unsigned Idx, uint8_t Raw) const;
+
+public:
+  W8378xMonitor(SMBus &SMB, uint8_t Addr, bool Is782D)
+      : HWMonitor(Is782D ? "W83782D" : "W83781D", SMB, Addr), Is782D(Is782D) {}
+  /// Checks the vendor and chip IDs at \p Addr. \Returns null if not a
+  /// supported chip.
+  static std::unique_ptr<HWMonitor> probe(SMBus &SMB, uint8_t Addr);
+  /// Reads the configuration. \Returns false on error.
+  bool init();
+  bool sample(HWMonSample &Sample) override;
+  unsigned getTransactionsPerSample() const override;
+};
+
+/// Samples a monitor periodically and keeps the recent history.
+class HWMonSampler {
+public:
+  static constexpr const unsigned HistorySize = 64;
+
+private:
+  HWMonitor &Mon;
+  RingBuffer<HWMonSample, HistorySize> History;
+
+public:
+  HWMonSampler(HWMonitor &Mon) : Mon(Mon) {}
+  /// Takes a sample and adds it to the history. \Returns false on error.
+  bool sample();
+  const RingBuffer<HWMonSample, HistorySize> &getHistory() const {
+    return History;
+  }
+  /// Prints the newest sample along with the peaks within the history.
+  void printLast(std::ostream &OS) const;
+  /// Samples every \p IntervalMillis, forever or \p Count times if not 0.
+  bool run(unsigned IntervalMillis, unsigned Count = 0);
+};
+
+#endif // __SRC_HWMON_H__
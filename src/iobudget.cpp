@@ -0,0 +1,150 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "iobudget.h"
+#include "chips.h"
+#include "pci.h"
+#include "portio.h"
+#include "session.h"
+#include "simsis540.h"
+#include <functional>
+#include <iomanip>
+
+// Raise these only along with a reason in the commit message. The time is
+// mostly the 100ms that SiSSMBus::transfer() sleeps per transaction, with
+// some slack for a busy host.
+const std::vector<IOBudget> IOBudgetCheck::Budgets = {
+    // The host bridge and LPC IDs, enabling ACPI and reading its base. Two
+    // ports per configuration access.
+    {"discover", 0, 13, 26, 0, 10, {}},
+    // The quick write check.
+    {"attach", 1, 0, 8, 110, 110, {"writeQuick(0x69)"}},
+    {"list", 0, 0, 0, 0, 10, {}},
+    // Draining the 8 bytes of the block costs a status write.
+    {"get", 1, 0, 19, 1100, 110, {"readBlockData(0x69, 0x0)"}},
+    // Write the key, then read back the register for the enable bit.
+    {"set",
+     4,
+     0,
+     60,
+     2960,
+     420,
+     {"readBlockData(0x69, 0x0)", "writeBlockData(0x69, 0x0)",
+      "readBlockData(0x69, 0x0)", "writeBlockData(0x69, 0x0)"}},
+    // Setting the current frequency costs the same, nothing skips it yet.
+    {"same",
+     4,
+     0,
+     60,
+     2960,
+     420,
+     {"readBlockData(0x69, 0x0)", "writeBlockData(0x69, 0x0)",
+      "readBlockData(0x69, 0x0)", "writeBlockData(0x69, 0x0)"}},
+};
+
+void IOBudgetCheck::printDiff(const std::vector<std::string> &Expected,
+                              const std::vector<std::string> &Got) {
+  // The longest common subsequence, the traces are short.
+  size_t NumE = Expected.size();
+  size_t NumG = Got.size();
+  std::vector<std::vector<unsigned>> LCS(NumE + 1,
+                                         std::vector<unsigned>(NumG + 1, 0));
+  for (size_t E = NumE; E-- > 0;)
+    for (size_t G = NumG; G-- > 0;)
+      LCS[E][G] = Expected[E] == Got[G]
+                      ? LCS[E + 1][G + 1] + 1
+                      : std::max(LCS[E + 1][G], LCS[E][G + 1]);
+  size_t E = 0;
+  size_t G = 0;
+  while (E != NumE || G != NumG) {
+    if (E != NumE && G != NumG && Expected[E] == Got[G]) {
+      std::cout << "      " << Got[G] << '\n';
+      ++E, ++G;
+    } else if (G != NumG && (E == NumE || LCS[E][G + 1] >= LCS[E + 1][G])) {
+      std::cout << "    + " << Got[G++] << '\n';
+    } else {
+      std::cout << "    - " << Expected[E++] << '\n';
+    }
+  }
+}
+
+bool IOBudgetCheck::run() {
+  bool Success = true;
+  Chips AllChips;
+  for (const auto &P : AllChips.getPLLs()) {
+    const std::string &PLLName = P->getName();
+    // A fresh board for each PLL, so that each one runs the discovery.
+    auto BoardPtr = std::make_unique<SimSiS540>();
+    SimSMBus &Sim = BoardPtr->Bus;
+    Sim.addDevice(PLL::SlaveAddr,
+                  std::vector<uint8_t>(SimSMBus::PLLRegs, 0));
+    PortIO::install(std::move(BoardPtr));
+    Session S(/*UseCache=*/false);
+    std::optional<FreqEntry> Current;
+    std::optional<FreqEntry> Other;
+
+    auto Exec = [&](const std::string &Name) -> bool {
+      if (Name == "discover")
+        return S.discover();
+      if (Name == "attach")
+        return S.attachPLL(PLLName);
+      if (Name == "list")
+        return !S.listFrequencies().empty();
+      if (Name == "get") {
+        Current = S.getFrequency();
+        return Current.has_value();
+      }
+      if (!Current)
+        return false;
+      if (Name == "set") {
+        for (const FreqEntry &FE : S.listFrequencies())
+          if (!(FE == *Current)) {
+            Other = FE;
+            break;
+          }
+        return Other && S.setFrequency(*Other);
+      }
+      if (Name == "same")
+        return Other && S.setFrequency(*Other);
+      return false;
+    };
+
+    for (const IOBudget &B : Budgets) {
+      unsigned long StartSMBus = SMBus::Transactions;
+      unsigned long StartPCI = PCI::ConfigAccesses;
+      unsigned long StartPorts = PortIO::Accesses;
+      Sim.SimMicros = 0;
+      Sim.Trace.clear();
+      Sim.Tracing = true;
+      uint64_t StartMillis = getMillis();
+      bool Ran = Exec(B.Name);
+      uint64_t Millis = getMillis() - StartMillis;
+      Sim.Tracing = false;
+      unsigned long NumSMBus = SMBus::Transactions - StartSMBus;
+      unsigned long NumPCI = PCI::ConfigAccesses - StartPCI;
+      unsigned long NumPorts = PortIO::Accesses - StartPorts;
+      bool SameTrace = Sim.Trace == B.Expected;
+      bool Ok = Ran && SameTrace && NumSMBus <= B.MaxSMBus &&
+                NumPCI <= B.MaxPCI && NumPorts <= B.MaxPorts &&
+                Sim.SimMicros <= B.MaxSimMicros && Millis <= B.MaxMillis;
+      DecimalGuard DG(std::cout);
+      std::cout << "  " << PLLName << " " << std::left << std::setw(6)
+                << B.Name << std::right << " smb " << NumSMBus << "/"
+                << B.MaxSMBus << " pci " << NumPCI << "/" << B.MaxPCI
+                << " ports " << NumPorts << "/" << B.MaxPorts << " sim "
+                << Sim.SimMicros << "/" << B.MaxSimMicros << "us time "
+                << Millis << "/" << B.MaxMillis << "ms " << (Ok ? "OK" : "FAILED") << '\n';
+      if (!Ran)
+        std::cout << "    The command failed" << '\n';
+      if (!SameTrace || (!Ok && Ran))
+        printDiff(B.Expected, Sim.Trace);
+      Success &= Ok;
+    }
+    PortIO::finish();
+  }
+  std::cout << "I/O budget check " << (Success ? "passed" : "FAILED")
+            << std::endl;
+  return Success;
+}
@@ -0,0 +1,47 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// The -io-budget self-check. It runs the discovery and each PLL command
+// against a simulated SiS540 board and fails if one costs more I/O than its
+// budget, so that changes to the SMBus and PCI paths can't make them slower
+// unnoticed.
+//
+
+#ifndef __SRC_IOBUDGET_H__
+#define __SRC_IOBUDGET_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct IOBudget {
+  /// The command: discover, attach, list, get, set or same.
+  const char *Name;
+  unsigned long MaxSMBus;
+  unsigned long MaxPCI;
+  unsigned long MaxPorts;
+  /// The time the transactions take on a 100KHz bus. This is the wire time
+  /// only, it leaves out the waits for the controller.
+  uint64_t MaxSimMicros;
+  /// The wall-clock time of the command, waits included.
+  uint64_t MaxMillis;
+  /// The SMBus transactions we expect, as traced by SimSMBus.
+  std::vector<std::string> Expected;
+};
+
+class IOBudgetCheck {
+  static const std::vector<IOBudget> Budgets;
+
+  /// Prints the difference between \p Expected and \p Got, one transaction
+  /// per line, '-' for missing ones and '+' for extra ones.
+  static void printDiff(const std::vector<std::string> &Expected,
+                        const std::vector<std::string> &Got);
+
+public:
+  /// Runs the commands for all supported PLLs. \Returns false if any of them
+  /// went over budget.
+  static bool run();
+};
+
+#endif // __SRC_IOBUDGET_H__
@@ -0,0 +1,67 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "log.h"
+#include <cstdio>
+#include <iostream>
+
+bool Debug = false;
+
+ConsoleBuf::int_type ConsoleBuf::overflow(int_type C) {
+  sync();
+  if (C != traits_type::eof()) {
+    *pptr() = traits_type::to_char_type(C);
+    pbump(1);
+  }
+  return traits_type::not_eof(C);
+}
+
+int ConsoleBuf::sync() {
+  std::ptrdiff_t Len = pptr() - pbase();
+  if (Len != 0) {
+    std::fwrite(pbase(), 1, Len, stdout);
+    setp(Buf, Buf + BufSize);
+  }
+  std::fflush(stdout);
+  return 0;
+}
+
+ConsoleBuf::~ConsoleBuf() {
+  sync();
+  if (OrigBuf != nullptr)
+    std::cout.rdbuf(OrigBuf);
+}
+
+void ConsoleBuf::install() {
+  // Destroyed at exit(), after flushing.
+  static ConsoleBuf Console;
+  if (Console.OrigBuf == nullptr)
+    Console.OrigBuf = std::cout.rdbuf(&Console);
+}
+
+std::ostream &operator<<(std::ostream &OS, const Hex &H) {
+  static const char Digits[] = "0123456789abcdef";
+  char Str[8];
+  unsigned Len = 0;
+  uint32_t Val = H.Val;
+  do {
+    Str[sizeof(Str) - ++Len] = Digits[Val & 0xf];
+    Val >>= 4;
+  } while (Val != 0);
+  for (unsigned Pad = Len; Pad < H.Width && Pad < sizeof(Str); ++Pad)
+    Str[sizeof(Str) - ++Len] = '0';
+  return OS.write(Str + sizeof(Str) - Len, Len);
+}
+
+std::ostream &operator<<(std::ostream &OS, const Dec &D) {
+  char Str[10];
+  unsigned Len = 0;
+  uint32_t Val = D.Val;
+  do {
+    Str[sizeof(Str) - ++Len] = '0' + Val % 10;
+    Val /= 10;
+  } while (Val != 0);
+  return OS.write(Str + sizeof(Str) - Len, Len);
+}
@@ -0,0 +1,74 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Logging helpers. Writing to the DOS console is slow, so std::cout goes
+// through a buffer that is flushed once per phase or before any error
+// message, and the debug messages can be compiled out altogether.
+//
+
+#ifndef __SRC_LOG_H__
+#define __SRC_LOG_H__
+
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+enum class LogLevel {
+  Error = 0,
+  Warning = 1,
+  Info = 2,
+  Debug = 3,
+};
+
+/// The most verbose level that gets compiled in. Build with LOG_LEVEL=2 to
+/// drop the debug messages.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 3
+#endif
+static constexpr const LogLevel MaxLogLevel = (LogLevel)LOG_LEVEL;
+
+/// Whether we should print debug info (-debug).
+extern bool Debug;
+
+/// \Returns true if debug messages should be printed. This is a constant
+/// false if they are compiled out, so the whole `if` goes away.
+static inline bool isDebug() {
+  return MaxLogLevel >= LogLevel::Debug && Debug;
+}
+
+/// A fixed-size buffer in front of stdout.
+class ConsoleBuf final : public std::streambuf {
+  static constexpr const unsigned BufSize = 4096;
+  char Buf[BufSize];
+  std::streambuf *OrigBuf = nullptr;
+
+protected:
+  int_type overflow(int_type C) override;
+  int sync() override;
+
+public:
+  ConsoleBuf() { setp(Buf, Buf + BufSize); }
+  ~ConsoleBuf();
+  /// Redirects std::cout through the buffer. std::cerr stays unbuffered but
+  /// it is tied to std::cout, so errors show up in order.
+  static void install();
+};
+
+/// Prints \p Val in hex with at least \p Width digits and no "0x" prefix,
+/// without touching the stream flags.
+struct Hex {
+  uint32_t Val;
+  unsigned Width;
+  Hex(uint32_t Val, unsigned Width = 0) : Val(Val), Width(Width) {}
+  friend std::ostream &operator<<(std::ostream &OS, const Hex &H);
+};
+
+/// Prints \p Val in decimal, without touching the stream flags.
+struct Dec {
+  uint32_t Val;
+  Dec(uint32_t Val) : Val(Val) {}
+  friend std::ostream &operator<<(std::ostream &OS, const Dec &D);
+};
+
+#endif // __SRC_LOG_H__
@@ -3,17 +3,50 @@
 // Copyright (C) 2025 Scrap Computing
 //
 
+#include <cstdlib>
 #include <iostream>
 #include "sisfsb.h"
 #include "args.h"
+#include "portio.h"
 
 static constexpr const char *VERSION = "0.1";
 
 static void usage() {
   static const char *BinName = "sisfsb";
   std::cerr << "Usage:" << std::endl;
-  std::cerr << BinName << " -pll <PLL | help> -fsb <FSB/SDRAM/PCI|"
-            << FreqEntry::ListStr << "> [-h|-help] [-debug] [-v|-version]"
+  std::cerr << BinName << " -pll <PLL | auto | help> -fsb <FSB/SDRAM/PCI|"
+            << FreqEntry::ListStr << "> [-ramp <DwellMillis>] [-no-spd-check]"
+            << " [-stress-cpu <Seconds>]" << std::endl;
+  std::cerr << BinName
+            << " -pll <PLL | auto> -governor fast=<FSB/SDRAM/PCI>,"
+               "cool=<FSB/SDRAM/PCI>[,up=<%>,down=<%>,temp=<C>,"
+               "interval=<Millis>,dwell=<Millis>,writes=<PerHour>,"
+               "samples=<N>,stat=<File>] [-sim-pll]"
+            << std::endl;
+  std::cerr << BinName << " -pll <PLL | auto> -fsb <FSB/SDRAM/PCI> -settle"
+            << std::endl;
+  std::cerr << BinName << " -script <File> [-pll <PLL>] [-sim-pll]"
+            << std::endl;
+  std::cerr << BinName << " -stress-cpu <Seconds>" << std::endl;
+  std::cerr << BinName
+            << " -snapshot <save <File> [-pll <PLL>]|restore <File>|"
+               "diff <File> <File>>"
+            << std::endl;
+  std::cerr << BinName << " -lspci" << std::endl;
+  std::cerr << BinName << " -io-budget" << std::endl;
+  std::cerr << BinName << " -mnpll-check" << std::endl;
+  std::cerr << BinName << " -scan-smbus" << std::endl;
+  std::cerr << BinName << " -spd" << std::endl;
+  std::cerr << BinName << " -monitor <IntervalMillis>" << std::endl;
+  std::cerr << BinName << " -dram" << std::endl;
+  std::cerr << BinName
+            << " -chipset-opt <list|show|profile|enable <name>|disable <name>>"
+            << std::endl;
+  std::cerr << BinName << " -pci-tune <dry-run|apply|restore>" << std::endl;
+  std::cerr << BinName << " -mtrr <list|wc|remove <N>> [-msr-file <File>]"
+            << std::endl;
+  std::cerr << "Options for all modes: [-h|-help] [-debug] [-timing] "
+               "[-no-cache] [-record <File>|-replay <File>] [-v|-version]"
             << std::endl;
 }
 
@@ -26,7 +59,7 @@ static bool parseOpts(int Argc, char **Argv, Arguments &Args) {
       if (ArgCandidate == "-" + Arg || ArgCandidate == "--" + Arg)
         return true;
       if (AltArgRaw != nullptr) {
-        std::string AltArg(ArgRaw);
+        std::string AltArg(AltArgRaw);
         if (ArgCandidate == "-" + AltArg || ArgCandidate == "--" + AltArg)
           return true;
       }
@@ -64,30 +97,247 @@ static bool parseOpts(int Argc, char **Argv, Arguments &Args) {
         return false;
       continue;
     }
+    if (MatchArg(Arg, "ramp")) {
+      if (auto ArgStrOpt = TryGetNextArg()) {
+        int Dwell = std::atoi(ArgStrOpt->c_str());
+        if (Dwell < 0) {
+          std::cerr << "Bad ramp dwell time '" << *ArgStrOpt << "'!"
+                    << std::endl;
+          return false;
+        }
+        Args.RampDwellMillis = Dwell;
+      } else {
+        std::cerr << "Missing ramp dwell time!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "governor")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.Governor = *ArgStrOpt;
+      else {
+        std::cerr << "Missing governor configuration!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "script")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.Script = *ArgStrOpt;
+      else {
+        std::cerr << "Missing script file!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "settle")) {
+      Args.Settle = true;
+      continue;
+    }
+    if (MatchArg(Arg, "stress-cpu")) {
+      if (auto ArgStrOpt = TryGetNextArg()) {
+        int Seconds = std::atoi(ArgStrOpt->c_str());
+        if (Seconds <= 0) {
+          std::cerr << "Bad stress time '" << *ArgStrOpt << "'!" << std::endl;
+          return false;
+        }
+        Args.StressCPUSeconds = Seconds;
+      } else {
+        std::cerr << "Missing stress time!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "lspci")) {
+      Args.ListPCI = true;
+      continue;
+    }
+    if (MatchArg(Arg, "snapshot")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.Snapshot = toLower(*ArgStrOpt);
+      if (Args.Snapshot != "save" && Args.Snapshot != "restore" &&
+          Args.Snapshot != "diff") {
+        std::cerr << "Bad snapshot command '" << Args.Snapshot << "'!"
+                  << std::endl;
+        return false;
+      }
+      int NumFiles = Args.Snapshot == "diff" ? 2 : 1;
+      if (ArgIdx + 1 + NumFiles >= Argc) {
+        std::cerr << "Missing snapshot file!" << std::endl;
+        return false;
+      }
+      Args.SnapshotFile = Argv[ArgIdx + 2];
+      if (NumFiles == 2)
+        Args.SnapshotFile2 = Argv[ArgIdx + 3];
+      continue;
+    }
+    if (MatchArg(Arg, "io-budget")) {
+      Args.IOBudget = true;
+      continue;
+    }
+    if (MatchArg(Arg, "mnpll-check")) {
+      Args.MNPLLCheck = true;
+      continue;
+    }
+    if (MatchArg(Arg, "sim-pll")) {
+      Args.SimPLL = true;
+      continue;
+    }
+    if (MatchArg(Arg, "scan-smbus")) {
+      Args.ScanSMBus = true;
+      continue;
+    }
+    if (MatchArg(Arg, "monitor")) {
+      if (auto ArgStrOpt = TryGetNextArg()) {
+        int Interval = std::atoi(ArgStrOpt->c_str());
+        if (Interval <= 0) {
+          std::cerr << "Bad monitor interval '" << *ArgStrOpt << "'!"
+                    << std::endl;
+          return false;
+        }
+        Args.MonitorIntervalMillis = Interval;
+      } else {
+        std::cerr << "Missing monitor interval!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "dram")) {
+      Args.ShowDRAM = true;
+      continue;
+    }
+    if (MatchArg(Arg, "chipset-opt")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.ChipsetOpt = toLower(*ArgStrOpt);
+      else {
+        std::cerr << "Missing chipset-opt command!" << std::endl;
+        return false;
+      }
+      if (Args.ChipsetOpt == "enable" || Args.ChipsetOpt == "disable") {
+        if (ArgIdx + 2 >= Argc) {
+          std::cerr << "Missing chipset-opt feature name!" << std::endl;
+          return false;
+        }
+        Args.ChipsetOptName = toLower(Argv[ArgIdx + 2]);
+      } else if (Args.ChipsetOpt != "list" && Args.ChipsetOpt != "show" &&
+                 Args.ChipsetOpt != "profile") {
+        std::cerr << "Bad chipset-opt command '" << Args.ChipsetOpt << "'!"
+                  << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "pci-tune")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.PCITune = toLower(*ArgStrOpt);
+      if (Args.PCITune != "dry-run" && Args.PCITune != "apply" &&
+          Args.PCITune != "restore") {
+        std::cerr << "Bad pci-tune command '" << Args.PCITune << "'!"
+                  << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "mtrr")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.MTRR = toLower(*ArgStrOpt);
+      if (Args.MTRR == "remove") {
+        if (ArgIdx + 2 >= Argc) {
+          std::cerr << "Missing MTRR index!" << std::endl;
+          return false;
+        }
+        char *End = nullptr;
+        Args.MTRRIdx = strtoul(Argv[ArgIdx + 2], &End, 10);
+        if (End == Argv[ArgIdx + 2] || *End != '\0') {
+          std::cerr << "Bad MTRR index '" << Argv[ArgIdx + 2] << "'!"
+                    << std::endl;
+          return false;
+        }
+      } else if (Args.MTRR != "list" && Args.MTRR != "wc") {
+        std::cerr << "Bad mtrr command '" << Args.MTRR << "'!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "msr-file")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.MSRFile = *ArgStrOpt;
+      else {
+        std::cerr << "Missing MSR file!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "spd")) {
+      Args.ShowSPD = true;
+      continue;
+    }
+    if (MatchArg(Arg, "no-spd-check")) {
+      Args.IgnoreSPD = true;
+      continue;
+    }
+    if (MatchArg(Arg, "timing")) {
+      Args.ShowTiming = true;
+      continue;
+    }
+    if (MatchArg(Arg, "record")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.RecordFile = *ArgStrOpt;
+      else {
+        std::cerr << "Missing record file!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "replay")) {
+      if (auto ArgStrOpt = TryGetNextArg())
+        Args.ReplayFile = *ArgStrOpt;
+      else {
+        std::cerr << "Missing replay file!" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    if (MatchArg(Arg, "no-cache")) {
+      Args.NoCache = true;
+      continue;
+    }
     if (MatchArg(Arg, "debug")) {
       Debug = true;
+      if (!isDebug())
+        std::cerr << "Debug messages were compiled out (LOG_LEVEL="
+                  << LOG_LEVEL << ")" << std::endl;
       continue;
     }
   }
+  if (!Args.RecordFile.empty() && !Args.ReplayFile.empty()) {
+    std::cerr << "Can't both record and replay!" << std::endl;
+    return false;
+  }
   return true;
 }
 
-bool Debug = false;
-
 int main(int Argc, char **Argv) {
-  std::cout << R"( ____   _  ____   _____  ____   ____  )" << std::endl;
-  std::cout << R"(/ ___| (_)/ ___| |  ___|/ ___| | __ ) )" << std::endl;
-  std::cout << R"(\___ \ | |\___ \ | |_   \___ \ |  _ \ )" << std::endl;
-  std::cout << R"( ___) || | ___) ||  _|   ___) || |_) |)" << std::endl;
-  std::cout << R"(|____/ |_||____/ |_|    |____/ |____/ )" << std::endl;
-  std::cout << R"(                     by Scrap Computing  v)" << VERSION << std::endl;
+  ConsoleBuf::install();
+  std::cout << R"( ____   _  ____   _____  ____   ____  )" << '\n';
+  std::cout << R"(/ ___| (_)/ ___| |  ___|/ ___| | __ ) )" << '\n';
+  std::cout << R"(\___ \ | |\___ \ | |_   \___ \ |  _ \ )" << '\n';
+  std::cout << R"( ___) || | ___) ||  _|   ___) || |_) |)" << '\n';
+  std::cout << R"(|____/ |_||____/ |_|    |____/ |____/ )" << '\n';
+  std::cout << R"(                     by Scrap Computing  v)" << VERSION << '\n';
   Arguments Args;
   if (!parseOpts(Argc, Argv, Args)) {
     usage();
     return 1;
   }
   std::cout << Args << std::endl;
+  if (!Args.RecordFile.empty() && !PortIO::record(Args.RecordFile))
+    return 1;
+  if (!Args.ReplayFile.empty() && !PortIO::replay(Args.ReplayFile))
+    return 1;
   SiSFSB SiSFSB(Args);
   bool Success = SiSFSB.run();
+  // A replay that diverged from the log is a failure too.
+  Success &= PortIO::finish();
   return Success ? 0 : 1;
 }
@@ -0,0 +1,107 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "mnpllcheck.h"
+#include "chips.h"
+#include "simsmbus.h"
+#include <cmath>
+#include <iomanip>
+
+// The reference model. It is not a real part, it only has the shape of one:
+// the usual 14.31818MHz crystal, a 150-400MHz VCO, a 6-bit M and an 8-bit N
+// and post dividers of 2, 3 and 4, which cover 37.5-200MHz without gaps.
+static constexpr const float RefClockMHz = 14.31818;
+static constexpr const float VCOMinMHz = 150;
+static constexpr const float VCOMaxMHz = 400;
+static constexpr const unsigned MMin = 2;
+static constexpr const unsigned MMax = 63;
+static constexpr const unsigned NMin = 8;
+static constexpr const unsigned NMax = 255;
+/// How far the solution may be from a whole MHz FSB.
+static constexpr const float MaxErrMHz = 0.5;
+
+static MNPLL makeModel() {
+  return MNPLL(
+      /*Name=*/"MN-reference",
+      /*KeyRegister=*/0,
+      /*KeyBits=*/{4, 5},
+      {
+          {0, {100.0, 100.0, 33.3}},
+          {1, {100.0, 133.3, 33.3}},
+          {2, {66.6, 100.0, 33.3}},
+          {3, {133.3, 133.3, 33.3}},
+      },
+      /*EnableI2CRegister=*/0,
+      /*EnableI2CBit=*/3, RefClockMHz,
+      /*M=*/{{{3, 0, 6}}, MMin, MMax},
+      /*N=*/{{{4, 0, 8}}, NMin, NMax},
+      /*PostDivField=*/{{5, 0, 2}},
+      /*PostDivs=*/{{0, 2}, {1, 3}, {2, 4}}, VCOMinMHz, VCOMaxMHz,
+      /*MNEnableBit=*/{5, 7, 1});
+}
+
+/// \Returns true if \p Sol is a valid divider setting that gives its FSB.
+static bool isValid(const MNPLL::Solution &Sol) {
+  static const unsigned PostDivs[] = {2, 3, 4};
+  if (Sol.M < MMin || Sol.M > MMax || Sol.N < NMin || Sol.N > NMax ||
+      Sol.PostDivRegVal >= std::size(PostDivs))
+    return false;
+  float VCO = RefClockMHz * Sol.N / Sol.M;
+  float Fsb = VCO / PostDivs[Sol.PostDivRegVal];
+  return VCO >= VCOMinMHz && VCO <= VCOMaxMHz &&
+         std::abs(Fsb - Sol.FsbMHz) < 0.001;
+}
+
+bool MNPLLCheck::run() {
+  bool Success = true;
+  DecimalGuard DG(std::cout);
+  std::cout << std::fixed << std::setprecision(2);
+  MNPLL Model = makeModel();
+  auto [MinFsb, MaxFsb] = Model.getFsbRange();
+
+  // Every whole MHz in the range.
+  unsigned Missed = 0;
+  float WorstErr = 0;
+  for (long Fsb = std::lround(std::ceil(MinFsb));
+       Fsb <= std::lround(std::floor(MaxFsb)); ++Fsb) {
+    std::optional<MNPLL::Solution> Sol = Model.solve(Fsb);
+    float Err = Sol ? std::abs(Sol->FsbMHz - Fsb) : MaxErrMHz + 1;
+    if (!Sol || !isValid(*Sol) || Err > MaxErrMHz) {
+      std::cout << "    " << Fsb << "MHz: "
+                << (Sol ? "bad dividers" : "no solution") << '\n';
+      ++Missed;
+    }
+    WorstErr = std::max(WorstErr, Err);
+  }
+  std::cout << "  solve " << MinFsb << "-" << MaxFsb << "MHz worst error "
+            << WorstErr << "MHz " << (Missed == 0 ? "OK" : "FAILED") << '\n';
+  Success &= Missed == 0;
+
+  // Nothing outside of it.
+  bool Outside = !Model.solve(MinFsb - 1) && !Model.solve(MaxFsb + 1);
+  std::cout << "  range " << (Outside ? "OK" : "FAILED") << '\n';
+  Success &= Outside;
+
+  // Write the dividers to a simulated PLL and read them back.
+  for (float Fsb : {66.0f, 103.0f, 127.0f, 150.0f}) {
+    SimSMBus Sim;
+    Sim.addDevice(PLL::SlaveAddr,
+                  std::vector<uint8_t>(SimSMBus::PLLRegs, 0));
+    FreqEntry Want(Fsb, Fsb, Fsb / 3);
+    std::optional<MNPLL::Solution> Sol = Model.solve(Fsb);
+    std::optional<FreqEntry> Got;
+    if (Sol && Model.setFSB(Want, Sim))
+      Got = Model.getFSB(Sim);
+    bool Ok = Got && std::abs(Got->getFsb() - Sol->FsbMHz) < 0.001 &&
+              std::abs(Got->getSdram() - Sol->FsbMHz) < 0.001 &&
+              Model.getEnabled(Sim);
+    std::cout << "  round trip " << std::setprecision(0) << Fsb << "MHz "
+              << (Ok ? "OK" : "FAILED") << '\n';
+    Success &= Ok;
+  }
+  std::cout << "M/N solver check " << (Success ? "passed" : "FAILED")
+            << std::endl;
+  return Success;
+}
@@ -0,0 +1,20 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// The -mnpll-check self-check. It runs the MNPLL divider solver over a
+// reference model and fails if any whole MHz FSB in its range is missed by
+// more than half a MHz, or if the dividers don't survive a trip through the
+// register block.
+//
+
+#ifndef __SRC_MNPLLCHECK_H__
+#define __SRC_MNPLLCHECK_H__
+
+class MNPLLCheck {
+public:
+  /// Runs all the checks. \Returns false if any of them failed.
+  static bool run();
+};
+
+#endif // __SRC_MNPLLCHECK_H__
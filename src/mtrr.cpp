@@ -0,0 +1,248 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "mtrr.h"
+#include "cpu.h"
+#include "utils.h"
+#include <iomanip>
+
+#ifndef LINUX
+std::optional<uint64_t> NativeMSRBackend::read(uint32_t Reg) {
+  uint32_t Lo, Hi;
+  asm volatile("rdmsr" : "=a"(Lo), "=d"(Hi) : "c"(Reg));
+  return (uint64_t)Hi << 32 | Lo;
+}
+
+bool NativeMSRBackend::write(uint32_t Reg, uint64_t Val) {
+  uint32_t Lo = Val & 0xffffffff;
+  uint32_t Hi = Val >> 32;
+  asm volatile("wrmsr" : : "c"(Reg), "a"(Lo), "d"(Hi) : "memory");
+  return true;
+}
+
+void NativeMSRBackend::beginUpdate() {
+  // Intel SDM: disable interrupts, enter no-fill cache mode and flush.
+  asm volatile("cli\n\t"
+               "movl %%cr0, %%eax\n\t"
+               "orl $0x40000000, %%eax\n\t"
+               "movl %%eax, %%cr0\n\t"
+               "wbinvd"
+               :
+               :
+               : "eax", "memory");
+}
+
+void NativeMSRBackend::endUpdate() {
+  asm volatile("wbinvd\n\t"
+               "movl %%cr0, %%eax\n\t"
+               "andl $0xbfffffff, %%eax\n\t"
+               "movl %%eax, %%cr0\n\t"
+               "sti"
+               :
+               :
+               : "eax", "memory");
+}
+#endif // LINUX
+
+FileMSRBackend::FileMSRBackend(const std::string &Path) : Path(Path) {
+  File = std::fopen(Path.c_str(), "r+b");
+  if (File == nullptr) {
+    std::cerr << "Failed to open " << Path << std::endl;
+    return;
+  }
+  // Unbuffered, so that the file is up to date even if we crash.
+  std::setvbuf(File, nullptr, _IONBF, 0);
+}
+
+FileMSRBackend::~FileMSRBackend() {
+  if (File != nullptr)
+    std::fclose(File);
+}
+
+std::optional<uint64_t> FileMSRBackend::read(uint32_t Reg) {
+  uint8_t Bytes[8] = {};
+  if (std::fseek(File, Reg * 8l, SEEK_SET) != 0)
+    return std::nullopt;
+  // Registers past the end of the file read as 0.
+  std::fread(Bytes, 1, sizeof(Bytes), File);
+  uint64_t Val = 0;
+  for (int Idx = 7; Idx >= 0; --Idx)
+    Val = Val << 8 | Bytes[Idx];
+  return Val;
+}
+
+bool FileMSRBackend::write(uint32_t Reg, uint64_t Val) {
+  uint8_t Bytes[8];
+  for (unsigned Idx = 0; Idx != 8; ++Idx)
+    Bytes[Idx] = (Val >> (Idx * 8)) & 0xff;
+  if (std::fseek(File, Reg * 8l, SEEK_SET) != 0)
+    return false;
+  return std::fwrite(Bytes, 1, sizeof(Bytes), File) == sizeof(Bytes);
+}
+
+MTRR::MTRR(MSRBackend &MSR) : MSR(MSR) {
+  PhysAddrMask = ((1ull << CPU::getPhysAddrBits()) - 1) & ~0xfffull;
+}
+
+const char *MTRR::getTypeName(uint8_t Type) {
+  switch (Type) {
+  case 0:
+    return "UC";
+  case 1:
+    return "WC";
+  case 4:
+    return "WT";
+  case 5:
+    return "WP";
+  case 6:
+    return "WB";
+  default:
+    return "??";
+  }
+}
+
+void MTRR::Range::print(std::ostream &OS) const {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << "MTRR" << std::dec << Idx << ": ";
+  if (!Valid)
+    OS << "free";
+  else
+    OS << "base 0x" << std::hex << std::setw(9) << std::setfill('0') << Base
+       << std::setfill(' ') << " size " << std::dec << Size / 1024 << "KB "
+       << getTypeName(Type);
+  OS.flags(SvFlags);
+}
+
+bool MTRR::supportsWC() {
+  if (!CPU::hasFeatures(CPU::MTRRMask | CPU::MSRMask))
+    return false;
+  auto Cap = MSR.read(MTRRCapMSR);
+  return Cap && (*Cap & WCSupportedMask);
+}
+
+std::optional<std::vector<MTRR::Range>> MTRR::getRanges() {
+  auto Cap = MSR.read(MTRRCapMSR);
+  if (!Cap)
+    return std::nullopt;
+  std::vector<Range> Ranges;
+  for (unsigned Idx = 0, E = *Cap & VCntMask; Idx != E; ++Idx) {
+    auto Base = MSR.read(PhysBase0MSR + 2 * Idx);
+    auto Mask = MSR.read(PhysMask0MSR + 2 * Idx);
+    if (!Base || !Mask)
+      return std::nullopt;
+    // The mask is contiguous, so its lowest set bit is the size. This does
+    // not depend on the physical address width, unlike ~Mask + 1.
+    uint64_t AddrMask = *Mask & PhysAddrMask;
+    uint64_t Size = AddrMask & -AddrMask;
+    Ranges.push_back({Idx, *Base & PhysAddrMask, Size,
+                      (uint8_t)(*Base & TypeMask), (bool)(*Mask & ValidMask)});
+  }
+  return Ranges;
+}
+
+bool MTRR::addRange(uint64_t Base, uint64_t Size, uint8_t Type) {
+  if (Size < 0x1000 || (Size & (Size - 1)) != 0 || (Base & (Size - 1)) != 0) {
+    std::cerr << "MTRR range must be a power of 2 of at least 4KB and aligned"
+              << std::endl;
+    return false;
+  }
+  auto Ranges = getRanges();
+  if (!Ranges)
+    return false;
+  const Range *Free = nullptr;
+  for (const Range &R : *Ranges) {
+    if (!R.Valid) {
+      if (Free == nullptr)
+        Free = &R;
+      continue;
+    }
+    // Overlapping WC with anything else is either ineffective (UC wins) or
+    // undefined, so don't.
+    if (Base < R.Base + R.Size && R.Base < Base + Size) {
+      std::cerr << "Overlaps with ";
+      R.print(std::cerr);
+      std::cerr << std::endl;
+      return false;
+    }
+  }
+  if (Free == nullptr) {
+    std::cerr << "No free variable range MTRR" << std::endl;
+    return false;
+  }
+  auto DefType = MSR.read(MTRRDefTypeMSR);
+  if (!DefType)
+    return false;
+  MSR.beginUpdate();
+  bool Success = MSR.write(MTRRDefTypeMSR, *DefType & ~EnableMask) &&
+                 MSR.write(PhysBase0MSR + 2 * Free->Idx, Base | Type) &&
+                 MSR.write(PhysMask0MSR + 2 * Free->Idx,
+                           (~(Size - 1) & PhysAddrMask) | ValidMask);
+  Success &= MSR.write(MTRRDefTypeMSR, *DefType);
+  MSR.endUpdate();
+  return Success;
+}
+
+bool MTRR::removeRange(unsigned Idx) {
+  auto Cap = MSR.read(MTRRCapMSR);
+  if (!Cap || Idx >= (*Cap & VCntMask)) {
+    std::cerr << "No variable range MTRR " << std::dec << Idx << std::endl;
+    return false;
+  }
+  auto DefType = MSR.read(MTRRDefTypeMSR);
+  if (!DefType)
+    return false;
+  MSR.beginUpdate();
+  bool Success = MSR.write(MTRRDefTypeMSR, *DefType & ~EnableMask) &&
+                 MSR.write(PhysMask0MSR + 2 * Idx, 0) &&
+                 MSR.write(PhysBase0MSR + 2 * Idx, 0);
+  Success &= MSR.write(MTRRDefTypeMSR, *DefType);
+  MSR.endUpdate();
+  return Success;
+}
+
+std::optional<PCIMemBAR> findVGAFrameBuffer() {
+  static constexpr const uint8_t DisplayClass = 0x03;
+  static constexpr const uint8_t FirstBARReg = 0x10;
+  static constexpr const uint8_t LastBARReg = 0x24;
+  static constexpr const uint32_t IOSpaceMask = 0x1;
+  static constexpr const uint32_t Mem64Mask = 0x4;
+  static constexpr const uint32_t PrefetchableMask = 0x8;
+  static constexpr const uint16_t MemDecodeMask = 0x2;
+  std::optional<PCIMemBAR> Best;
+  bool BestPrefetchable = false;
+  PCI::forEachFunction([&Best, &BestPrefetchable](const BDF &Addr) -> bool {
+    if (PCI::readByte(Addr, PCI::ClassReg) != DisplayClass)
+      return false;
+    uint16_t Cmd = PCI::readWord(Addr, PCI::CommandReg);
+    for (uint8_t Reg = FirstBARReg; Reg <= LastBARReg; Reg += 4) {
+      uint32_t BAR = PCI::readDword(Addr, Reg);
+      if (BAR == 0 || (BAR & IOSpaceMask))
+        continue;
+      // Size the BAR with memory decoding off, so that the display does not
+      // see the frame buffer move around.
+      PCI::writeWord(Addr, PCI::CommandReg, Cmd & ~MemDecodeMask);
+      PCI::writeDword(Addr, Reg, 0xffffffff);
+      uint32_t SizeBits = PCI::readDword(Addr, Reg);
+      PCI::writeDword(Addr, Reg, BAR);
+      PCI::writeWord(Addr, PCI::CommandReg, Cmd);
+      uint64_t Base = BAR & ~0xfu;
+      uint64_t Size = (uint32_t)(~(SizeBits & ~0xfu) + 1);
+      if (BAR & Mem64Mask) {
+        Reg += 4;
+        Base |= (uint64_t)PCI::readDword(Addr, Reg) << 32;
+      }
+      bool Prefetchable = BAR & PrefetchableMask;
+      // Prefer prefetchable BARs, then the largest one.
+      if (!Best || (Prefetchable && !BestPrefetchable) ||
+          (Prefetchable == BestPrefetchable && Size > Best->Size)) {
+        Best = PCIMemBAR{Addr, Reg, Base, Size};
+        BestPrefetchable = Prefetchable;
+      }
+    }
+    // Stop at the first VGA function.
+    return true;
+  });
+  return Best;
+}
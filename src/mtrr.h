@@ -0,0 +1,121 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Memory Type Range Registers, used for mapping the frame buffer of the
+// integrated VGA as write-combining.
+//
+
+#ifndef __SRC_MTRR_H__
+#define __SRC_MTRR_H__
+
+#include "pci.h"
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// Access to the Model Specific Registers.
+class MSRBackend {
+public:
+  virtual ~MSRBackend() = default;
+  virtual std::optional<uint64_t> read(uint32_t Reg) = 0;
+  virtual bool write(uint32_t Reg, uint64_t Val) = 0;
+  /// Called before and after changing the MTRRs, for disabling the caches.
+  virtual void beginUpdate() {}
+  virtual void endUpdate() {}
+  virtual const char *getName() const = 0;
+};
+
+#ifndef LINUX
+/// Uses RDMSR/WRMSR directly. These need ring 0, so use CWSDPR0.EXE instead of
+/// CWSDPMI.EXE.
+class NativeMSRBackend final : public MSRBackend {
+public:
+  std::optional<uint64_t> read(uint32_t Reg) override;
+  bool write(uint32_t Reg, uint64_t Val) override;
+  void beginUpdate() override;
+  void endUpdate() override;
+  const char *getName() const override { return "RDMSR/WRMSR"; }
+};
+#endif // LINUX
+
+/// Reads and writes simulated MSRs in a plain file, with each MSR at offset
+/// MSR * 8. Used for testing the MTRR logic without ring 0. Not for the Linux
+/// /dev/cpu/<N>/msr device: it only reaches one CPU and we can't flush the
+/// caches around the update or tell the kernel about it.
+class FileMSRBackend final : public MSRBackend {
+  std::string Path;
+  std::FILE *File = nullptr;
+
+public:
+  FileMSRBackend(const std::string &Path);
+  ~FileMSRBackend();
+  bool isOpen() const { return File != nullptr; }
+  std::optional<uint64_t> read(uint32_t Reg) override;
+  bool write(uint32_t Reg, uint64_t Val) override;
+  const char *getName() const override { return Path.c_str(); }
+};
+
+class MTRR {
+public:
+  static constexpr const uint32_t MTRRCapMSR = 0xfe;
+  static constexpr const uint32_t MTRRDefTypeMSR = 0x2ff;
+  static constexpr const uint32_t PhysBase0MSR = 0x200;
+  static constexpr const uint32_t PhysMask0MSR = 0x201;
+  /// MTRRcap bits.
+  static constexpr const uint64_t VCntMask = 0xff;
+  static constexpr const uint64_t WCSupportedMask = 1u << 10;
+  /// MTRRdefType bit that enables the MTRRs.
+  static constexpr const uint64_t EnableMask = 1u << 11;
+  /// PhysMask bit that enables the range.
+  static constexpr const uint64_t ValidMask = 1u << 11;
+  static constexpr const uint64_t TypeMask = 0xff;
+  static constexpr const uint8_t UncacheableType = 0;
+  static constexpr const uint8_t WriteCombiningType = 1;
+
+  /// A variable range MTRR.
+  struct Range {
+    unsigned Idx;
+    uint64_t Base;
+    uint64_t Size;
+    uint8_t Type;
+    bool Valid;
+    void print(std::ostream &OS) const;
+  };
+
+private:
+  MSRBackend &MSR;
+  uint64_t PhysAddrMask;
+
+public:
+  MTRR(MSRBackend &MSR);
+  /// \Returns the variable range MTRRs, or nullopt on error.
+  std::optional<std::vector<Range>> getRanges();
+  /// Programs a free variable range MTRR with \p Type. \p Base must be
+  /// aligned to \p Size, which must be a power of 2. \Returns false on error.
+  bool addRange(uint64_t Base, uint64_t Size, uint8_t Type);
+  /// Disables the variable range MTRR \p Idx. \Returns false on error.
+  bool removeRange(unsigned Idx);
+  /// \Returns true if the CPU has MTRRs with write-combining support.
+  bool supportsWC();
+
+  static const char *getTypeName(uint8_t Type);
+};
+
+/// A memory BAR of a PCI function.
+struct PCIMemBAR {
+  BDF Addr;
+  uint8_t Reg;
+  uint64_t Base;
+  uint64_t Size;
+};
+
+/// \Returns the largest prefetchable memory BAR of the first VGA function,
+/// which is the frame buffer.
+std::optional<PCIMemBAR> findVGAFrameBuffer();
+
+#endif // __SRC_MTRR_H__
@@ -4,6 +4,8 @@
 //
 
 #include "pci.h"
+#include "pciids.h"
+#include <iomanip>
 
 void PCI::forEachBDF(std::function<bool(const BDF &)> Fn) {
   for (uint16_t Bus = BDF::BusMin; Bus != BDF::BusMax; ++Bus) {
@@ -18,17 +20,62 @@ void PCI::forEachBDF(std::function<bool(const BDF &)> Fn) {
   }
 }
 
+void PCI::forEachFunction(std::function<bool(const BDF &)> Fn) {
+  for (uint16_t Bus = BDF::BusMin; Bus != BDF::BusMax; ++Bus) {
+    for (uint16_t Dev = BDF::DevMin; Dev != BDF::DevMax; ++Dev) {
+      BDF Fun0(Bus, Dev, 0);
+      if (readWord(Fun0, VendorIdReg) == 0xffff)
+        continue;
+      bool MultiFun = readByte(Fun0, HeaderTypeReg) & MultiFunctionMask;
+      uint16_t FunMax = MultiFun ? BDF::FunMax : 1;
+      for (uint16_t Fun = BDF::FunMin; Fun != FunMax; ++Fun) {
+        BDF BDF(Bus, Dev, Fun);
+        if (Fun != 0 && readWord(BDF, VendorIdReg) == 0xffff)
+          continue;
+        if (Fn(BDF))
+          return;
+      }
+    }
+  }
+}
+
 void PCI::listDevices(std::ostream &OS) {
-  forEachBDF([&OS](const BDF &BDF) -> bool {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::hex << std::setfill('0');
+  forEachFunction([&OS](const BDF &BDF) -> bool {
     // Reading a single double-word should be faster than reading two words, one
     // for Vendor ID and one for Device ID.
     uint32_t DWord = readDword(BDF, VendorIdReg);
     uint16_t VendorId = DWord & 0x0000ffff;
-    uint16_t DeviceId = DWord & 0xffff0000;
-    OS << BDF << std::hex << VendorId << ":" << DeviceId << std::dec << "\n";
+    uint16_t DeviceId = DWord >> 16;
+    uint32_t ClassDWord = readDword(BDF, RevisionIdReg);
+    uint8_t Class = ClassDWord >> 24;
+    uint8_t SubClass = ClassDWord >> 16;
+    OS << std::setw(2) << BDF.Bus << ":" << std::setw(2) << BDF.Dev << "."
+       << BDF.Fun << " ";
+    if (const char *ClassName = PCIIDs::getClass(Class, SubClass))
+      OS << ClassName;
+    else
+      OS << "Class " << std::setw(2) << (int)Class << std::setw(2)
+         << (int)SubClass;
+    OS << ": ";
+    const char *VendorName = PCIIDs::getVendor(VendorId);
+    const char *DeviceName = PCIIDs::getDevice(VendorId, DeviceId);
+    if (VendorName != nullptr)
+      OS << VendorName << " ";
+    else
+      OS << "Vendor " << std::setw(4) << VendorId << " ";
+    if (DeviceName != nullptr)
+      OS << DeviceName;
+    else
+      OS << "Device " << std::setw(4) << DeviceId;
+    OS << " [" << std::setw(4) << VendorId << ":" << std::setw(4) << DeviceId
+       << "]" << '\n';
     // Don't stop iterating.
     return false;
   });
+  OS.flags(SvFlags);
+  OS << std::setfill(' ');
 }
 
 void PCI::listDevices() { listDevices(std::cout); }
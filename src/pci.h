@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include "portio.h"
 #include "utils.h"
 
 /// Geographical addressing of PCI devices.
@@ -57,11 +58,28 @@ public:
   static constexpr const uint16_t VendorIdReg = 0;
   /// The word containging the Device ID.
   static constexpr const uint16_t DeviceIdReg = 2;
+  /// The standard header registers.
+  static constexpr const uint16_t CommandReg = 0x04;
+  /// The dword with the revision ID and the class code.
+  static constexpr const uint16_t RevisionIdReg = 0x08;
+  static constexpr const uint16_t SubClassReg = 0x0a;
+  static constexpr const uint16_t ClassReg = 0x0b;
+  static constexpr const uint16_t CacheLineSizeReg = 0x0c;
+  static constexpr const uint16_t LatencyTimerReg = 0x0d;
+  static constexpr const uint16_t HeaderTypeReg = 0x0e;
+  /// Bits of the CommandReg.
+  static constexpr const uint16_t BusMasterMask = 0x0004;
+  static constexpr const uint16_t MemWriteInvalidateMask = 0x0010;
+  /// Bit 7 of the HeaderTypeReg.
+  static constexpr const uint8_t MultiFunctionMask = 0x80;
+  /// The number of config space accesses so far, for -timing.
+  static inline unsigned long ConfigAccesses = 0;
 
   static uint8_t readByte(const BDF &BDF, uint16_t Reg) {
+    ++ConfigAccesses;
     uint32_t Addr = BDF.getAddr(Reg);
-    outportl(PCI_CONFIG_ADDR, Addr);
-    return inportb(PCI_CONFIG_DATA + (Reg & 0x03));
+    PortIO::outl(PCI_CONFIG_ADDR, Addr);
+    return PortIO::inb(PCI_CONFIG_DATA + (Reg & 0x03));
   }
   static uint16_t readWord(const BDF &BDF, uint16_t Reg) {
     uint16_t Res = readByte(BDF, Reg);
@@ -69,28 +87,34 @@ public:
     return Res;
   }
   static uint32_t readDword(const BDF &BDF, uint16_t Reg) {
+    ++ConfigAccesses;
     uint32_t Addr = BDF.getAddr(Reg);
-    outportl(PCI_CONFIG_ADDR, Addr);
-    return inportl(PCI_CONFIG_DATA + (Reg & 0x03));
+    PortIO::outl(PCI_CONFIG_ADDR, Addr);
+    return PortIO::inl(PCI_CONFIG_DATA + (Reg & 0x03));
   }
   static void writeByte(const BDF &BDF, uint16_t Reg, uint8_t Val) {
+    ++ConfigAccesses;
     uint32_t Addr = BDF.getAddr(Reg);
-    outportl(PCI_CONFIG_ADDR, Addr);
-    outportb(PCI_CONFIG_DATA + (Reg & 0x03), Val);
+    PortIO::outl(PCI_CONFIG_ADDR, Addr);
+    PortIO::outb(PCI_CONFIG_DATA + (Reg & 0x03), Val);
   }
   static void writeWord(const BDF &BDF, uint16_t Reg, uint16_t Val) {
     writeByte(BDF, Reg, Val);
     writeByte(BDF, Reg + 1, Val >> 8);
   }
   static void writeDword(const BDF &BDF, uint16_t Reg, uint32_t Val) {
+    ++ConfigAccesses;
     uint32_t Addr = BDF.getAddr(Reg);
-    outportl(PCI_CONFIG_ADDR, Addr);
-    outportl(PCI_CONFIG_DATA + (Reg & 0x03), Val);
+    PortIO::outl(PCI_CONFIG_ADDR, Addr);
+    PortIO::outl(PCI_CONFIG_DATA + (Reg & 0x03), Val);
   }
   /// Runs \p Fn on each available BDF in the PCI address range. If \p Fn()
   /// returns true the iteration stops.
   static void forEachBDF(std::function<bool(const BDF &)> Fn);
-  /// Prints all PCI devices.
+  /// Like forEachBDF() but only visits functions that exist. It skips the
+  /// functions 1-7 of single-function devices, which makes it a lot faster.
+  static void forEachFunction(std::function<bool(const BDF &)> Fn);
+  /// Prints all PCI functions, with their names from pci.ids.
   static void listDevices(std::ostream &OS);
   /// Prints all PCI devices to std::cout.
   static void listDevices();
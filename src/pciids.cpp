@@ -0,0 +1,39 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "pciids.h"
+// Generated from pci.ids by genpciids, see the Makefile.
+#include "pciids.inc"
+
+#include <iterator>
+
+static const PCIIDs::Table IDTable = {IDSeeds, std::size(IDSeeds), IDSlots,
+                                      std::size(IDSlots)};
+static const PCIIDs::Table ClassTable = {ClassSeeds, std::size(ClassSeeds),
+                                         ClassSlots, std::size(ClassSlots)};
+
+const char *PCIIDs::lookup(const Table &T, uint32_t Key) {
+  uint32_t Seed = T.Seeds[hash(Key, 0) % T.NumBuckets];
+  const Entry &E = T.Slots[hash(Key, Seed) % T.NumSlots];
+  return E.Key == Key ? Names + E.NameOff : nullptr;
+}
+
+const char *PCIIDs::getVendor(uint16_t VendorId) {
+  return lookup(IDTable, VendorId);
+}
+
+const char *PCIIDs::getDevice(uint16_t VendorId, uint16_t DeviceId) {
+  return lookup(IDTable, getDeviceKey(VendorId, DeviceId));
+}
+
+const char *PCIIDs::getClass(uint8_t Class, uint8_t SubClass) {
+  if (const char *Name = lookup(ClassTable, (uint32_t)Class << 8 | SubClass))
+    return Name;
+  return lookup(ClassTable, ClassOnlyMask | (uint32_t)Class << 8);
+}
+
+uint32_t PCIIDs::getNumIDs() { return NumIDs; }
+
+uint32_t PCIIDs::getNumClasses() { return NumClasses; }
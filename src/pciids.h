@@ -0,0 +1,67 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Vendor, device and class names from a subset of pci.ids (pci.ids in this
+// directory). genpciids turns it into perfect hash tables at build time, so
+// a lookup is two hashes and one compare, and all names live in one
+// deduplicated string blob.
+//
+
+#ifndef __SRC_PCIIDS_H__
+#define __SRC_PCIIDS_H__
+
+#include <cstdint>
+
+class PCIIDs {
+public:
+  /// A slot of a perfect hash table.
+  struct Entry {
+    uint32_t Key;
+    /// The offset of the name in the string blob.
+    uint16_t NameOff;
+  };
+  /// A perfect hash table: the key hashed with seed 0 picks a bucket, and the
+  /// key hashed with that bucket's seed picks the slot.
+  struct Table {
+    const uint16_t *Seeds;
+    uint32_t NumBuckets;
+    const Entry *Slots;
+    uint32_t NumSlots;
+  };
+  /// Marks the unused slots, no vendor has ID 0xffff.
+  static constexpr const uint32_t EmptyKey = 0xffffffff;
+
+  /// The keys: the vendor ID for vendors, Vendor << 16 | Device for devices,
+  /// Class << 8 | SubClass for subclasses and ClassOnlyMask | Class << 8 for
+  /// the base classes.
+  static uint32_t getDeviceKey(uint16_t VendorId, uint16_t DeviceId) {
+    return (uint32_t)VendorId << 16 | DeviceId;
+  }
+  static constexpr const uint32_t ClassOnlyMask = 0x10000;
+
+  /// Shared with genpciids, so changing it needs no other changes.
+  static uint32_t hash(uint32_t Key, uint32_t Seed) {
+    // The murmur3 finalizer.
+    uint32_t H = Key ^ (Seed * 0x9e3779b9);
+    H ^= H >> 16;
+    H *= 0x85ebca6b;
+    H ^= H >> 13;
+    H *= 0xc2b2ae35;
+    H ^= H >> 16;
+    return H;
+  }
+
+  /// \Returns the name for \p Key in \p T, or null if not found.
+  static const char *lookup(const Table &T, uint32_t Key);
+
+  static const char *getVendor(uint16_t VendorId);
+  static const char *getDevice(uint16_t VendorId, uint16_t DeviceId);
+  /// \Returns the subclass name or, if not known, the base class name.
+  static const char *getClass(uint8_t Class, uint8_t SubClass);
+  /// \Returns the number of vendors + devices and of classes compiled in.
+  static uint32_t getNumIDs();
+  static uint32_t getNumClasses();
+};
+
+#endif // __SRC_PCIIDS_H__
@@ -0,0 +1,133 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "pcitune.h"
+#include "utils.h"
+#include <fstream>
+#include <iomanip>
+
+PCIFunctionHeader PCIFunctionHeader::read(const BDF &Addr) {
+  PCIFunctionHeader H{Addr, 0, 0, 0, 0, 0, 0, 0, 0};
+  // Read whole dwords, it's fewer port accesses than byte by byte.
+  uint32_t ID = PCI::readDword(Addr, PCI::VendorIdReg);
+  H.VendorID = ID & 0xffff;
+  H.DeviceID = ID >> 16;
+  H.Command = PCI::readDword(Addr, PCI::CommandReg) & 0xffff;
+  uint32_t ClassRev = PCI::readDword(Addr, 0x08);
+  H.SubClass = (ClassRev >> 16) & 0xff;
+  H.Class = ClassRev >> 24;
+  uint32_t Misc = PCI::readDword(Addr, PCI::CacheLineSizeReg);
+  H.CacheLineSize = Misc & 0xff;
+  H.LatencyTimer = (Misc >> 8) & 0xff;
+  H.HeaderType = (Misc >> 16) & 0xff;
+  return H;
+}
+
+void PCIRegChange::print(std::ostream &OS) const {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::hex << std::setfill('0') << std::setw(2) << Addr.Bus << ":"
+     << std::setw(2) << Addr.Dev << "." << Addr.Fun << " reg 0x"
+     << std::setw(2) << (int)Reg << ": 0x" << std::setw(2) << (int)OldVal
+     << " -> 0x" << std::setw(2) << (int)NewVal << std::setfill(' ');
+  switch (Reg) {
+  case PCI::LatencyTimerReg:
+    OS << " (latency timer)";
+    break;
+  case PCI::CacheLineSizeReg:
+    OS << " (cache line size)";
+    break;
+  case PCI::CommandReg:
+    OS << " (command: memory write and invalidate)";
+    break;
+  }
+  OS.flags(SvFlags);
+}
+
+std::vector<PCIRegChange> PCITuner::plan() {
+  std::vector<PCIRegChange> Changes;
+  PCI::forEachFunction([&Changes](const BDF &Addr) -> bool {
+    PCIFunctionHeader H = PCIFunctionHeader::read(Addr);
+    // Leave the host and ISA bridges alone, the BIOS knows better.
+    if (H.Class == BridgeClass && (H.SubClass == HostBridgeSubClass ||
+                                   H.SubClass == ISABridgeSubClass))
+      return false;
+    // The latency timer only matters for bus masters.
+    if (!H.isBusMaster())
+      return false;
+    uint8_t Latency = (H.Class == MassStorageClass || H.Class == NetworkClass ||
+                       H.Class == MultimediaClass)
+                          ? StreamingLatency
+                          : DefaultLatency;
+    if (H.LatencyTimer < Latency)
+      Changes.push_back({Addr, PCI::LatencyTimerReg, H.LatencyTimer, Latency});
+    uint8_t CacheLineSize = H.CacheLineSize;
+    if (CacheLineSize == 0) {
+      CacheLineSize = CacheLineDwords;
+      Changes.push_back(
+          {Addr, PCI::CacheLineSizeReg, H.CacheLineSize, CacheLineSize});
+    }
+    // Memory Write and Invalidate needs a valid cache line size.
+    uint8_t Cmd = H.Command & 0xff;
+    if (CacheLineSize == CacheLineDwords &&
+        !(Cmd & PCI::MemWriteInvalidateMask))
+      Changes.push_back({Addr, PCI::CommandReg, Cmd,
+                         (uint8_t)(Cmd | PCI::MemWriteInvalidateMask)});
+    return false;
+  });
+  return Changes;
+}
+
+bool PCITuner::apply(const std::vector<PCIRegChange> &Changes) {
+  std::ofstream Backup(BackupFile);
+  if (!Backup) {
+    std::cerr << "Failed to create " << BackupFile << std::endl;
+    return false;
+  }
+  Backup << std::hex;
+  for (const PCIRegChange &C : Changes)
+    Backup << C.Addr.Bus << " " << C.Addr.Dev << " " << C.Addr.Fun << " "
+           << (int)C.Reg << " " << (int)C.OldVal << " " << (int)C.NewVal
+           << "\n";
+  Backup.close();
+  if (!Backup) {
+    std::cerr << "Failed to write " << BackupFile << std::endl;
+    return false;
+  }
+  for (const PCIRegChange &C : Changes) {
+    PCI::writeByte(C.Addr, C.Reg, C.NewVal);
+    // Some devices hardwire these registers, which is fine but worth saying.
+    uint8_t ReadBack = PCI::readByte(C.Addr, C.Reg);
+    if (ReadBack != C.NewVal) {
+      std::cout << "Not supported: ";
+      C.print(std::cout);
+      std::cout << " (reads 0x" << std::hex << (int)ReadBack << std::dec << ")"
+                << std::endl;
+    }
+  }
+  return true;
+}
+
+bool PCITuner::restore() {
+  std::ifstream Backup(BackupFile);
+  if (!Backup) {
+    std::cerr << "Failed to open " << BackupFile << std::endl;
+    return false;
+  }
+  std::vector<PCIRegChange> Changes;
+  unsigned Bus, Dev, Fun, Reg, OldVal, NewVal;
+  Backup >> std::hex;
+  while (Backup >> Bus >> Dev >> Fun >> Reg >> OldVal >> NewVal)
+    Changes.push_back({BDF(Bus, Dev, Fun), (uint8_t)Reg, (uint8_t)NewVal,
+                       (uint8_t)OldVal});
+  // Undo in reverse order, in case a register was changed more than once.
+  for (auto It = Changes.rbegin(), E = Changes.rend(); It != E; ++It) {
+    It->print(std::cout);
+    std::cout << std::endl;
+    PCI::writeByte(It->Addr, It->Reg, It->NewVal);
+  }
+  DecimalGuard DG(std::cout);
+  std::cout << "Restored " << Changes.size() << " registers" << std::endl;
+  return true;
+}
@@ -0,0 +1,72 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Tuning of the PCI latency timer, cache line size and Memory Write and
+// Invalidate of all PCI functions.
+//
+
+#ifndef __SRC_PCITUNE_H__
+#define __SRC_PCITUNE_H__
+
+#include "pci.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// The parts of the PCI header we look at.
+struct PCIFunctionHeader {
+  BDF Addr;
+  uint16_t VendorID;
+  uint16_t DeviceID;
+  uint16_t Command;
+  uint8_t Class;
+  uint8_t SubClass;
+  uint8_t CacheLineSize;
+  uint8_t LatencyTimer;
+  uint8_t HeaderType;
+
+  static PCIFunctionHeader read(const BDF &Addr);
+  bool isBusMaster() const { return Command & PCI::BusMasterMask; }
+};
+
+/// A single register write.
+struct PCIRegChange {
+  BDF Addr;
+  uint8_t Reg;
+  uint8_t OldVal;
+  uint8_t NewVal;
+  void print(std::ostream &OS) const;
+};
+
+class PCITuner {
+public:
+  /// The PCI class codes we treat specially.
+  static constexpr const uint8_t MassStorageClass = 0x01;
+  static constexpr const uint8_t NetworkClass = 0x02;
+  static constexpr const uint8_t MultimediaClass = 0x04;
+  static constexpr const uint8_t BridgeClass = 0x06;
+  static constexpr const uint8_t HostBridgeSubClass = 0x00;
+  static constexpr const uint8_t ISABridgeSubClass = 0x01;
+
+  /// Latency timers in PCI clocks. Storage and network controllers move the
+  /// most data, so they get longer bursts.
+  static constexpr const uint8_t StreamingLatency = 0x40;
+  static constexpr const uint8_t DefaultLatency = 0x20;
+  /// Cache line size in dwords (32 bytes on P6 and K6 CPUs).
+  static constexpr const uint8_t CacheLineDwords = 8;
+
+  /// Where apply() saves the original values for restore().
+  static constexpr const char *BackupFile = "PCITUNE.BAK";
+
+  /// \Returns the changes the policy would make, without writing anything.
+  static std::vector<PCIRegChange> plan();
+  /// Writes \p Changes after saving the old values to `BackupFile`.
+  /// \Returns false on error.
+  static bool apply(const std::vector<PCIRegChange> &Changes);
+  /// Writes back the values saved by apply(). \Returns false on error.
+  static bool restore();
+};
+
+#endif // __SRC_PCITUNE_H__
@@ -0,0 +1,242 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "portio.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// A log is the header (Magic, Version) followed by one record per access:
+//   Op:u8 Port:u16 Val:<Width bytes> DeltaMicros:LEB128
+// All little-endian. DeltaMicros is the time since the previous access.
+
+static void writeLE(std::ostream &OS, uint32_t Val, unsigned Bytes) {
+  for (unsigned Idx = 0; Idx != Bytes; ++Idx)
+    OS.put((char)(Val >> (8 * Idx)));
+}
+
+static bool readLE(std::istream &IS, uint32_t &Val, unsigned Bytes) {
+  Val = 0;
+  for (unsigned Idx = 0; Idx != Bytes; ++Idx) {
+    int C = IS.get();
+    if (C == EOF)
+      return false;
+    Val |= (uint32_t)C << (8 * Idx);
+  }
+  return true;
+}
+
+static bool isValidWidth(unsigned Width) { return Width == 1 || Width == 4; }
+
+namespace {
+
+class Recorder final : public PortIOHook {
+  std::string File;
+  std::ofstream OS;
+  uint64_t LastMicros;
+  unsigned long Cnt = 0;
+
+  void log(uint8_t Op, uint16_t Port, unsigned Width, uint32_t Val) {
+    uint64_t Now = getMicros();
+    uint64_t Delta = Now - LastMicros;
+    LastMicros = Now;
+    OS.put((char)Op);
+    writeLE(OS, Port, 2);
+    writeLE(OS, Val, Width);
+    do {
+      uint8_t Byte = Delta & 0x7f;
+      Delta >>= 7;
+      OS.put((char)(Delta != 0 ? Byte | 0x80 : Byte));
+    } while (Delta != 0);
+    ++Cnt;
+  }
+
+public:
+  Recorder(const std::string &File)
+      : File(File), OS(File, std::ios::binary | std::ios::trunc),
+        LastMicros(getMicros()) {
+    writeLE(OS, PortIO::Magic, 4);
+    writeLE(OS, PortIO::Version, 2);
+  }
+  bool good() const { return OS.good(); }
+  uint32_t in(uint16_t Port, unsigned Width) override {
+    uint32_t Val = Width == 1 ? inportb(Port) : inportl(Port);
+    log(Width, Port, Width, Val);
+    return Val;
+  }
+  void out(uint16_t Port, unsigned Width, uint32_t Val) override {
+    // Log it first and flush, so that the record is out of our buffer in
+    // case the write hangs the machine. This makes the writes slower than
+    // the reads, which the recorded times show.
+    log(PortIO::OutMask | Width, Port, Width, Val);
+    OS.flush();
+    if (Width == 1)
+      outportb(Port, Val);
+    else
+      outportl(Port, Val);
+  }
+  bool finish() override {
+    OS.close();
+    if (!OS) {
+      std::cerr << "Failed to write " << File << '\n';
+      return false;
+    }
+    DecimalGuard DG(std::cout);
+    std::cout << "Recorded " << Cnt << " port accesses to " << File << '\n';
+    return true;
+  }
+};
+
+class Replayer final : public PortIOHook {
+  struct Record {
+    uint8_t Op;
+    uint16_t Port;
+    uint32_t Val;
+    uint32_t DeltaMicros;
+  };
+  std::string File;
+  std::vector<Record> Log;
+  /// The number of accesses so far.
+  size_t Pos = 0;
+  uint64_t StartMicros = 0;
+  unsigned long Divergences = 0;
+  /// Don't drown the output if we went down a different path.
+  static constexpr const unsigned long MaxReports = 10;
+
+  void diverged(const char *What, uint16_t Port, unsigned Width,
+                uint32_t Val) {
+    if (Divergences++ >= MaxReports)
+      return;
+    std::cerr << "Replay diverged at access " << Dec(Pos) << ": " << What
+              << " " << Width << "@0x" << Hex(Port) << " val=0x" << Hex(Val);
+    if (Pos != 0 && Pos <= Log.size()) {
+      const Record &Rec = Log[Pos - 1];
+      std::cerr << ", log has " << ((Rec.Op & PortIO::OutMask) ? "out" : "in")
+                << " " << (Rec.Op & PortIO::WidthMask) << "@0x"
+                << Hex(Rec.Port) << " val=0x" << Hex(Rec.Val);
+    } else {
+      std::cerr << ", past the end of the log";
+    }
+    std::cerr << '\n';
+  }
+  /// \Returns the next record, or nullptr past the end of the log.
+  const Record *next() {
+    if (Pos == 0)
+      StartMicros = getMicros();
+    size_t Idx = Pos++;
+    return Idx < Log.size() ? &Log[Idx] : nullptr;
+  }
+
+public:
+  Replayer(const std::string &File) : File(File) {}
+  bool load() {
+    std::ifstream IS(File, std::ios::binary);
+    uint32_t Magic, Version;
+    if (!IS || !readLE(IS, Magic, 4) || !readLE(IS, Version, 2) ||
+        Magic != PortIO::Magic || Version != PortIO::Version) {
+      std::cerr << "Not a port I/O log: " << File << '\n';
+      return false;
+    }
+    while (IS.peek() != EOF) {
+      Record Rec;
+      uint32_t Op, Port;
+      bool Complete = readLE(IS, Op, 1) && readLE(IS, Port, 2) &&
+                      isValidWidth(Op & PortIO::WidthMask) &&
+                      readLE(IS, Rec.Val, Op & PortIO::WidthMask);
+      Rec.Op = Op;
+      Rec.Port = Port;
+      Rec.DeltaMicros = 0;
+      for (unsigned Shift = 0; Complete; Shift += 7) {
+        int C = IS.get();
+        if (C == EOF || Shift > 28) {
+          Complete = false;
+          break;
+        }
+        Rec.DeltaMicros |= (uint32_t)(C & 0x7f) << Shift;
+        if ((C & 0x80) == 0)
+          break;
+      }
+      if (!Complete) {
+        // The recording machine probably hung while writing the log.
+        DecimalGuard DG(std::cerr);
+        std::cerr << "Truncated record " << Log.size() << " in " << File
+                  << ", ignoring the rest" << '\n';
+        break;
+      }
+      Log.push_back(Rec);
+    }
+    return true;
+  }
+  uint32_t in(uint16_t Port, unsigned Width) override {
+    uint32_t AllOnes = Width == 1 ? 0xff : 0xffffffff;
+    const Record *Rec = next();
+    if (Rec == nullptr || (Rec->Op & PortIO::OutMask) ||
+        (Rec->Op & PortIO::WidthMask) != Width || Rec->Port != Port) {
+      // Nothing sensible to return, so pretend nothing is there.
+      diverged("in", Port, Width, AllOnes);
+      return AllOnes;
+    }
+    return Rec->Val;
+  }
+  void out(uint16_t Port, unsigned Width, uint32_t Val) override {
+    const Record *Rec = next();
+    if (Rec == nullptr || !(Rec->Op & PortIO::OutMask) ||
+        (Rec->Op & PortIO::WidthMask) != Width || Rec->Port != Port ||
+        Rec->Val != Val)
+      diverged("out", Port, Width, Val);
+  }
+  bool finish() override {
+    uint64_t Micros = Pos != 0 ? getMicros() - StartMicros : 0;
+    size_t Used = std::min(Pos, Log.size());
+    if (Used != Log.size()) {
+      DecimalGuard DG(std::cerr);
+      std::cerr << "Replay stopped " << Log.size() - Used
+                << " accesses before the end of the log" << '\n';
+      ++Divergences;
+    }
+    uint64_t RecordedMicros = 0;
+    for (size_t Idx = 1; Idx < Used; ++Idx)
+      RecordedMicros += Log[Idx].DeltaMicros;
+    DecimalGuard DG(std::cout);
+    std::cout << "Replayed " << Used << "/" << Log.size()
+              << " port accesses from " << File << ", " << Divergences
+              << " divergence(s), " << Micros << "us (recorded "
+              << RecordedMicros << "us)" << '\n';
+    return Divergences == 0;
+  }
+};
+
+} // namespace
+
+static void finishAtExit() { PortIO::finish(); }
+
+bool PortIO::record(const std::string &File) {
+  auto Rec = std::make_unique<Recorder>(File);
+  if (!Rec->good()) {
+    std::cerr << "Failed to create " << File << '\n';
+    return false;
+  }
+  Hook = std::move(Rec);
+  std::atexit(finishAtExit);
+  return true;
+}
+
+bool PortIO::replay(const std::string &File) {
+  auto Rep = std::make_unique<Replayer>(File);
+  if (!Rep->load())
+    return false;
+  Hook = std::move(Rep);
+  std::atexit(finishAtExit);
+  return true;
+}
+
+bool PortIO::finish() {
+  if (!Hook)
+    return true;
+  std::unique_ptr<PortIOHook> Done = std::move(Hook);
+  return Done->finish();
+}
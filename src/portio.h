@@ -0,0 +1,80 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// All the port I/O goes through here, so that a run can be recorded to a log
+// file (-record) and played back later without the hardware (-replay).
+//
+
+#ifndef __SRC_PORTIO_H__
+#define __SRC_PORTIO_H__
+
+#include "utils.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// Replaces the port accesses while installed.
+class PortIOHook {
+public:
+  virtual ~PortIOHook() = default;
+  /// \Returns the value read from \p Port, \p Width bytes wide.
+  virtual uint32_t in(uint16_t Port, unsigned Width) = 0;
+  virtual void out(uint16_t Port, unsigned Width, uint32_t Val) = 0;
+  /// Writes out the log or prints the replay summary. \Returns false on a
+  /// write error or if the replay diverged.
+  virtual bool finish() = 0;
+};
+
+class PortIO {
+  static inline std::unique_ptr<PortIOHook> Hook;
+
+public:
+  /// The log file format.
+  static constexpr const uint32_t Magic = 0x4f494653; // "SFIO"
+  static constexpr const uint16_t Version = 1;
+  /// Bit 7 of a record's op byte is set for writes, bits 0-2 hold the width.
+  static constexpr const uint8_t OutMask = 0x80;
+  static constexpr const uint8_t WidthMask = 0x07;
+
+  /// The number of port accesses so far, for -io-budget.
+  static inline unsigned long Accesses = 0;
+
+  static uint8_t inb(uint16_t Port) {
+    ++Accesses;
+    return Hook ? Hook->in(Port, 1) : inportb(Port);
+  }
+  static uint32_t inl(uint16_t Port) {
+    ++Accesses;
+    return Hook ? Hook->in(Port, 4) : inportl(Port);
+  }
+  static void outb(uint16_t Port, uint8_t Val) {
+    ++Accesses;
+    if (Hook)
+      Hook->out(Port, 1, Val);
+    else
+      outportb(Port, Val);
+  }
+  static void outl(uint16_t Port, uint32_t Val) {
+    ++Accesses;
+    if (Hook)
+      Hook->out(Port, 4, Val);
+    else
+      outportl(Port, Val);
+  }
+
+  /// Records all port accesses, and the values read, to \p File. \Returns
+  /// false if it can't be created.
+  static bool record(const std::string &File);
+  /// Serves the reads from the log in \p File instead of the hardware and
+  /// checks that the writes match it. \Returns false if it can't be read.
+  static bool replay(const std::string &File);
+  /// Serves all port accesses from \p H (e.g. a simulated board) until
+  /// finish().
+  static void install(std::unique_ptr<PortIOHook> H) { Hook = std::move(H); }
+  static bool isHooked() { return Hook != nullptr; }
+  /// Uninstalls the hook, see PortIOHook::finish(). Also runs at exit.
+  static bool finish();
+};
+
+#endif // __SRC_PORTIO_H__
@@ -0,0 +1,42 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#ifndef __SRC_RINGBUFFER_H__
+#define __SRC_RINGBUFFER_H__
+
+#include <array>
+#include <cstddef>
+
+/// A fixed-size buffer that keeps the last \p N elements pushed, overwriting
+/// the oldest one when full. It never allocates.
+template <typename T, std::size_t N> class RingBuffer {
+  std::array<T, N> Buffer;
+  /// Where the next element goes.
+  std::size_t Head = 0;
+  std::size_t Size = 0;
+
+public:
+  void push(const T &Elm) {
+    Buffer[Head] = Elm;
+    Head = (Head + 1) % N;
+    if (Size != N)
+      ++Size;
+  }
+  std::size_t size() const { return Size; }
+  bool empty() const { return Size == 0; }
+  static constexpr std::size_t capacity() { return N; }
+  /// \Returns the \p Idx'th element, with 0 being the oldest.
+  const T &operator[](std::size_t Idx) const {
+    return Buffer[(Head + N - Size + Idx) % N];
+  }
+  /// \Returns the newest element.
+  const T &back() const { return (*this)[Size - 1]; }
+  void clear() {
+    Head = 0;
+    Size = 0;
+  }
+};
+
+#endif // __SRC_RINGBUFFER_H__
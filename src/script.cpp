@@ -0,0 +1,335 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "script.h"
+#include "chips.h"
+#include "spd.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+/// \Returns the number in \p Str (decimal or 0x hex), or nullopt if it isn't
+/// one or if it is above \p Max.
+static std::optional<uint32_t> parseNum(const std::string &Str,
+                                        uint32_t Max = 0xffffffff) {
+  char *End = nullptr;
+  unsigned long Val = std::strtoul(Str.c_str(), &End, 0);
+  if (Str.empty() || *End != '\0' || Val > Max)
+    return std::nullopt;
+  return Val;
+}
+
+/// Parses "Bus:Dev.Fun" (or "Bus:Dev:Fun", like we print it).
+static std::optional<BDF> parseBDF(const std::string &Str) {
+  std::string Copy = Str;
+  std::replace(Copy.begin(), Copy.end(), '.', ':');
+  std::istringstream SS(Copy);
+  std::string BusStr, DevStr, FunStr;
+  if (!std::getline(SS, BusStr, ':') || !std::getline(SS, DevStr, ':') ||
+      !std::getline(SS, FunStr))
+    return std::nullopt;
+  auto Bus = parseNum(BusStr, BDF::BusMax - 1);
+  auto Dev = parseNum(DevStr, BDF::DevMax - 1);
+  auto Fun = parseNum(FunStr, BDF::FunMax - 1);
+  if (!Bus || !Dev || !Fun)
+    return std::nullopt;
+  return BDF(*Bus, *Dev, *Fun);
+}
+
+/// \Returns the width in bytes of "byte", "word" or "dword".
+static std::optional<unsigned> parseWidth(const std::string &Str) {
+  if (Str == "byte")
+    return 1;
+  if (Str == "word")
+    return 2;
+  if (Str == "dword")
+    return 4;
+  return std::nullopt;
+}
+
+bool Script::parseLine(const std::string &Line, unsigned LineNo,
+                       std::vector<ScriptCmd> &Cmds) {
+  std::string Text = Line.substr(0, Line.find('#'));
+  std::istringstream SS(toLower(Text));
+  std::vector<std::string> W;
+  for (std::string Word; SS >> Word;)
+    W.push_back(Word);
+  if (W.empty())
+    return true;
+
+  ScriptCmd Cmd;
+  Cmd.Line = LineNo;
+  // Drop the surrounding spaces.
+  Cmd.Text = W[0];
+  for (size_t Idx = 1; Idx != W.size(); ++Idx)
+    Cmd.Text += " " + W[Idx];
+  auto Error = [&Cmd](const char *Msg) {
+    DecimalGuard DG(std::cerr);
+    std::cerr << "Line " << Cmd.Line << ": " << Msg << ": '" << Cmd.Text
+              << "'" << '\n';
+    return false;
+  };
+  const std::string &Op = W.size() > 1 ? W[1] : std::string();
+
+  if (W[0] == "pci") {
+    bool Write = Op == "write";
+    if (!Write && Op != "read")
+      return Error("Expected pci read or pci write");
+    size_t NumArgs = Write ? 5 : 4;
+    if (W.size() != NumArgs && W.size() != NumArgs + 1)
+      return Error("Wrong number of arguments");
+    auto Dev = parseBDF(W[2]);
+    if (!Dev)
+      return Error("Bad Bus:Dev.Fun");
+    Cmd.Dev = *Dev;
+    if (W.size() == NumArgs + 1) {
+      auto Width = parseWidth(W.back());
+      if (!Width)
+        return Error("Expected byte, word or dword");
+      Cmd.Width = *Width;
+    }
+    auto Reg = parseNum(W[3], 0xff);
+    if (!Reg || *Reg % Cmd.Width != 0)
+      return Error("Bad or unaligned register");
+    Cmd.Reg = *Reg;
+    Cmd.K = ScriptCmd::Kind::PCIRead;
+    if (Write) {
+      auto Val = parseNum(W[4], 0xffffffff >> (32 - 8 * Cmd.Width));
+      if (!Val)
+        return Error("Bad value");
+      Cmd.Val = *Val;
+      Cmd.K = ScriptCmd::Kind::PCIWrite;
+    }
+  } else if (W[0] == "smbus") {
+    size_t NumArgs;
+    if (Op == "read") {
+      Cmd.K = ScriptCmd::Kind::SMBusRead;
+      NumArgs = 4;
+    } else if (Op == "write") {
+      Cmd.K = ScriptCmd::Kind::SMBusWrite;
+      NumArgs = 5;
+    } else if (Op == "block") {
+      Cmd.K = ScriptCmd::Kind::SMBusBlock;
+      NumArgs = 4;
+    } else
+      return Error("Expected smbus read, write or block");
+    if (W.size() != NumArgs)
+      return Error("Wrong number of arguments");
+    auto Addr = parseNum(W[2], SMBus::MaxAddr);
+    auto Reg = parseNum(W[3], 0xff);
+    if (!Addr || *Addr < SMBus::MinAddr || !Reg)
+      return Error("Bad address or command");
+    Cmd.Addr = *Addr;
+    Cmd.Reg = *Reg;
+    if (NumArgs == 5) {
+      auto Val = parseNum(W[4], 0xff);
+      if (!Val)
+        return Error("Bad value");
+      Cmd.Val = *Val;
+    }
+  } else if (W[0] == "pll") {
+    if (Op == "get" && W.size() == 2) {
+      Cmd.K = ScriptCmd::Kind::PLLGet;
+    } else if (Op == "set" && W.size() == 3) {
+      Cmd.K = ScriptCmd::Kind::PLLSet;
+      Cmd.FE = FreqEntry(W[2]);
+      if (Cmd.FE.bad())
+        return Error("Bad FSB/SDRAM/PCI");
+    } else
+      return Error("Expected pll get or pll set <FSB/SDRAM/PCI>");
+  } else if (W[0] == "delay") {
+    std::optional<uint32_t> Millis;
+    if (W.size() == 2)
+      Millis = parseNum(W[1]);
+    if (!Millis)
+      return Error("Expected delay <Millis>");
+    Cmd.K = ScriptCmd::Kind::Delay;
+    Cmd.Val = *Millis;
+  } else if (W[0] == "assert") {
+    if (W.size() < 2 || W.size() > 3)
+      return Error("Wrong number of arguments");
+    Cmd.K = ScriptCmd::Kind::Assert;
+    if (W[1].find('/') != std::string::npos && W.size() == 2) {
+      Cmd.FE = FreqEntry(W[1]);
+      if (Cmd.FE.bad())
+        return Error("Bad FSB/SDRAM/PCI");
+    } else {
+      auto Val = parseNum(W[1]);
+      std::optional<uint32_t> Mask = Cmd.Mask;
+      if (W.size() == 3)
+        Mask = parseNum(W[2]);
+      if (!Val || !Mask)
+        return Error("Bad value or mask");
+      Cmd.Val = *Val;
+      Cmd.Mask = *Mask;
+    }
+  } else
+    return Error("Unknown command");
+  Cmds.push_back(Cmd);
+  return true;
+}
+
+std::optional<Script> Script::load(const std::string &File) {
+  std::ifstream IS(File);
+  if (!IS) {
+    std::cerr << "Failed to open script " << File << '\n';
+    return std::nullopt;
+  }
+  Script Scr;
+  std::string Line;
+  bool Success = true;
+  // Check the whole script before we touch the hardware.
+  for (unsigned LineNo = 1; std::getline(IS, Line); ++LineNo)
+    Success &= parseLine(Line, LineNo, Scr.Cmds);
+  if (!Success)
+    return std::nullopt;
+  return Scr;
+}
+
+bool Script::needsSMBus() const {
+  return std::any_of(Cmds.begin(), Cmds.end(),
+                     [](const ScriptCmd &Cmd) { return Cmd.needsSMBus(); });
+}
+
+bool Script::needsPLL() const {
+  return std::any_of(Cmds.begin(), Cmds.end(), [](const ScriptCmd &Cmd) {
+    return Cmd.K == ScriptCmd::Kind::PLLGet ||
+           Cmd.K == ScriptCmd::Kind::PLLSet;
+  });
+}
+
+bool Script::exec(const ScriptCmd &Cmd, Session &S, bool CheckSPD) {
+  using Kind = ScriptCmd::Kind;
+  switch (Cmd.K) {
+  case Kind::PCIRead:
+    if (Cmd.Width == 1)
+      LastVal = PCI::readByte(Cmd.Dev, Cmd.Reg);
+    else if (Cmd.Width == 2)
+      LastVal = PCI::readWord(Cmd.Dev, Cmd.Reg);
+    else
+      LastVal = PCI::readDword(Cmd.Dev, Cmd.Reg);
+    std::cout << " = 0x" << *LastVal;
+    return true;
+  case Kind::PCIWrite:
+    LastVal.reset();
+    LastFE.reset();
+    if (Cmd.Width == 1)
+      PCI::writeByte(Cmd.Dev, Cmd.Reg, Cmd.Val);
+    else if (Cmd.Width == 2)
+      PCI::writeWord(Cmd.Dev, Cmd.Reg, Cmd.Val);
+    else
+      PCI::writeDword(Cmd.Dev, Cmd.Reg, Cmd.Val);
+    return true;
+  case Kind::SMBusRead: {
+    LastVal.reset();
+    auto Val = S.getSMB().readByteData(Cmd.Addr, Cmd.Reg);
+    if (!Val) {
+      std::cout << " failed";
+      return false;
+    }
+    LastVal = *Val;
+    std::cout << " = 0x" << *LastVal;
+    return true;
+  }
+  case Kind::SMBusWrite:
+    LastVal.reset();
+    LastFE.reset();
+    if (!S.getSMB().writeByteData(Cmd.Addr, Cmd.Reg, Cmd.Val)) {
+      std::cout << " failed";
+      return false;
+    }
+    return true;
+  case Kind::SMBusBlock: {
+    LastVal.reset();
+    std::vector<uint8_t> Block = S.getSMB().readBlockData(Cmd.Addr, Cmd.Reg);
+    if (Block.empty()) {
+      std::cout << " failed";
+      return false;
+    }
+    LastVal = Block[0];
+    std::cout << " =";
+    for (uint8_t Byte : Block)
+      std::cout << " 0x" << (int)Byte;
+    return true;
+  }
+  case Kind::PLLGet:
+    LastFE = S.getFrequency();
+    if (!LastFE) {
+      std::cout << " failed";
+      return false;
+    }
+    std::cout << " = " << *LastFE;
+    return true;
+  case Kind::PLLSet:
+    LastVal.reset();
+    LastFE.reset();
+    std::cout << '\n';
+    if (CheckSPD && !SPD::checkSdramLimit(S.getSMB(), Cmd.FE.getSdram()))
+      return false;
+    // Flush, in case the machine hangs.
+    std::cout << std::flush;
+    return S.setFrequency(Cmd.FE);
+  case Kind::Delay:
+    delay(Cmd.Val);
+    return true;
+  case Kind::Assert:
+    if (!Cmd.FE.bad()) {
+      if (LastFE && *LastFE == Cmd.FE)
+        return true;
+      std::cout << " FAILED, got ";
+      if (LastFE)
+        std::cout << *LastFE;
+      else
+        std::cout << "nothing";
+      return false;
+    }
+    if (LastVal && (*LastVal & Cmd.Mask) == Cmd.Val)
+      return true;
+    std::cout << " FAILED, got ";
+    if (LastVal)
+      std::cout << "0x" << (*LastVal & Cmd.Mask);
+    else
+      std::cout << "nothing";
+    return false;
+  }
+  return false;
+}
+
+bool Script::run(Session &S, const std::string &PLLName, bool CheckSPD) {
+  uint64_t StartMicros = getMicros();
+  unsigned Done = 0;
+  bool Success = true;
+  for (const ScriptCmd &Cmd : Cmds) {
+    // Attach the PLL on first use, outside of the command's timing.
+    bool NeedsPLL = Cmd.K == ScriptCmd::Kind::PLLGet ||
+                    Cmd.K == ScriptCmd::Kind::PLLSet;
+    if (NeedsPLL && !S.hasPLL() && !S.attachPLL(PLLName)) {
+      Success = false;
+      break;
+    }
+    uint64_t CmdStart = getMicros();
+    unsigned long StartSMBus = SMBus::Transactions;
+    unsigned long StartPCI = PCI::ConfigAccesses;
+    {
+      DecimalGuard DG(std::cout);
+      std::cout << std::setw(4) << Cmd.Line << ": " << Cmd.Text;
+    }
+    std::cout << std::hex;
+    Success = exec(Cmd, S, CheckSPD);
+    DecimalGuard DG(std::cout);
+    std::cout << " (" << getMicros() - CmdStart << "us, "
+              << SMBus::Transactions - StartSMBus << " smb, "
+              << PCI::ConfigAccesses - StartPCI << " pci)" << '\n';
+    if (!Success)
+      break;
+    ++Done;
+  }
+  DecimalGuard DG(std::cout);
+  std::cout << "Script: " << Done << "/" << Cmds.size() << " commands in "
+            << getMicros() - StartMicros << "us" << std::endl;
+  return Success;
+}
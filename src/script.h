@@ -0,0 +1,95 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// The -script mode: runs a list of PCI, SMBus and PLL operations in a single
+// process, after a single discovery pass. One command per line:
+//
+//   pci read <Bus:Dev.Fun> <Reg> [byte|word|dword]
+//   pci write <Bus:Dev.Fun> <Reg> <Val> [byte|word|dword]
+//   smbus read <Addr> <Cmd>
+//   smbus write <Addr> <Cmd> <Val>
+//   smbus block <Addr> <Cmd>
+//   pll get
+//   pll set <FSB/SDRAM/PCI>
+//   delay <Millis>
+//   assert <Val> [<Mask>]
+//   assert <FSB/SDRAM/PCI>
+//
+// Numbers are decimal, or hex with 0x. `assert` checks the result of the
+// previous read (the first byte for `smbus block`, the frequencies for
+// `pll get`). Everything after a '#' is a comment.
+//
+
+#ifndef __SRC_SCRIPT_H__
+#define __SRC_SCRIPT_H__
+
+#include "freqentry.h"
+#include "pci.h"
+#include "session.h"
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct ScriptCmd {
+  enum class Kind {
+    PCIRead,
+    PCIWrite,
+    SMBusRead,
+    SMBusWrite,
+    SMBusBlock,
+    PLLGet,
+    PLLSet,
+    Delay,
+    Assert,
+  };
+  Kind K;
+  /// The line number and the text, for the messages.
+  unsigned Line;
+  std::string Text;
+  BDF Dev = BDF(0, 0, 0);
+  uint16_t Reg = 0;
+  /// The PCI access width in bytes.
+  unsigned Width = 1;
+  uint8_t Addr = 0;
+  uint32_t Val = 0;
+  uint32_t Mask = 0xffffffff;
+  /// For `pll set` and `assert <FSB/SDRAM/PCI>`.
+  FreqEntry FE;
+
+  bool needsSMBus() const {
+    return K == Kind::SMBusRead || K == Kind::SMBusWrite ||
+           K == Kind::SMBusBlock || K == Kind::PLLGet || K == Kind::PLLSet;
+  }
+};
+
+class Script {
+  std::vector<ScriptCmd> Cmds;
+  /// The result of the previous read, for assert. Writes clear it, so that
+  /// an assert never checks a value read before them.
+  std::optional<uint32_t> LastVal;
+  std::optional<FreqEntry> LastFE;
+
+  /// Parses the command in \p Line. \Returns false on a syntax error.
+  static bool parseLine(const std::string &Line, unsigned LineNo,
+                        std::vector<ScriptCmd> &Cmds);
+  /// Runs \p Cmd, printing its result. \Returns false on error or if an
+  /// assertion failed.
+  bool exec(const ScriptCmd &Cmd, Session &S, bool CheckSPD);
+
+public:
+  /// Reads and checks the whole script in \p File. \Returns nullopt on error.
+  static std::optional<Script> load(const std::string &File);
+  /// \Returns true if any command needs the SMBus.
+  bool needsSMBus() const;
+  /// \Returns true if any command needs the PLL.
+  bool needsPLL() const;
+  /// Runs the commands in order, stopping at the first failure. The PLL
+  /// commands attach \p PLLName on first use. pll set is refused above the
+  /// SDRAM limit of the DIMMs if \p CheckSPD.
+  /// \Returns false if a command failed.
+  bool run(Session &S, const std::string &PLLName, bool CheckSPD);
+};
+
+#endif // __SRC_SCRIPT_H__
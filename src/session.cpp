@@ -0,0 +1,192 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "session.h"
+#include "clock.h"
+#include "portio.h"
+#include "timing.h"
+#include "utils.h"
+
+void Session::saveCache() {
+  if (!Cache->save(DiscoveryCache::DefaultFile) && isDebug())
+    std::cerr << "Failed to write " << DiscoveryCache::DefaultFile << '\n';
+}
+
+bool Session::findHostBridge() {
+  PhaseTimer Phase("host-bridge");
+  // Skip the discovery if we have been on this machine before.
+  if (UseCache) {
+    // The host bridge is always at 00:00.0.
+    Fingerprint = HWFingerprint::read(BDF(0, 0, 0));
+    Cache = DiscoveryCache::load(DiscoveryCache::DefaultFile, Fingerprint);
+    if (Cache)
+      HostBridge = AllChips.getHostBridge(Cache->HostBridge);
+  }
+  if (HostBridge != nullptr) {
+    std::cout << "Host bridge found (cached): " << *HostBridge << '\n';
+    if (isDebug()) {
+      Cache->print(std::cout);
+      std::cout << '\n';
+    }
+    return true;
+  }
+  Cache.reset();
+  // Find a supported host bridge based on VendorID/DeviceID.
+  HostBridge = AllChips.findHostBridge();
+  return HostBridge != nullptr;
+}
+
+bool Session::initSMB() {
+  PhaseTimer Phase("init-smb");
+  // Initialize the I2C (SMB) bus, which is where the PLL lives.
+  std::optional<uint16_t> KnownSMBAddr;
+  if (Cache && Cache->SMBusAddr != 0)
+    KnownSMBAddr = Cache->SMBusAddr;
+  if (!HostBridge->initSMB(KnownSMBAddr)) {
+    std::cerr << "Failed to initialize SMB" << '\n';
+    return false;
+  }
+  std::cout << "SMB initialized successfully" << '\n';
+  SMBus &SMB = getSMB();
+  // Time everything with the chipset timer, which does not change with the
+  // FSB. Not while recording or replaying, the busy loops would not replay.
+  if (std::optional<uint16_t> Port = HostBridge->getPMTimerPort();
+      Port && !PortIO::isHooked()) {
+    if (std::unique_ptr<ACPIPMTimer> Timer = ACPIPMTimer::probe(*Port))
+      ClockSource::install(std::move(Timer));
+    if (isDebug())
+      std::cout << "Clock source: " << ClockSource::get().getName() << '\n';
+  }
+  // End of the discovery phase.
+  std::cout << SMB << std::endl;
+  if (UseCache && (!Cache || Cache->SMBusAddr != SMB.getBaseAddr())) {
+    if (!Cache) {
+      Cache = DiscoveryCache();
+      Cache->Fingerprint = Fingerprint;
+      Cache->HostBridge = HostBridge->getName();
+    }
+    Cache->SMBusAddr = SMB.getBaseAddr();
+    saveCache();
+  }
+  return true;
+}
+
+bool Session::attachPLL(const std::string &PLLName) {
+  PhaseTimer Phase("detect-pll");
+  bool AutoPLL = toLower(PLLName) == PLL::AutoStr;
+  // A PLL that we talked to before needs neither detection nor checking.
+  bool CachedPLL = Cache && !Cache->PLL.empty() &&
+                   (AutoPLL || toLower(Cache->PLL) == toLower(PLLName));
+  Pll = nullptr;
+  if (AutoPLL && CachedPLL) {
+    Pll = AllChips.findPLL(Cache->PLL);
+    CachedPLL = Pll != nullptr;
+    if (CachedPLL)
+      std::cout << "PLL (cached): " << *Pll << '\n';
+  }
+  if (Pll == nullptr) {
+    Pll = AutoPLL ? AllChips.detectPLL(getSMB()) : AllChips.findPLL(PLLName);
+    // A named PLL is at the datasheet address, unless the cache knows better.
+    if (Pll != nullptr && !AutoPLL)
+      Pll->setAddr(PLL::SlaveAddr);
+  }
+  if (Pll == nullptr)
+    return false;
+  if (CachedPLL) {
+    if (Cache->PLLAddr != 0)
+      Pll->setAddr(Cache->PLLAddr);
+    return true;
+  }
+
+  Phase.next("check");
+  // Do a quick write check to the PLL.
+  if (!Pll->check(getSMB())) {
+    Pll = nullptr;
+    return false;
+  }
+  std::cout << "PLL Chip passed quick write check: " << *Pll << '\n';
+  return true;
+}
+
+std::optional<FreqEntry> Session::getFrequency() {
+  // Query PLL for FSB via the I2C Bus (SMBus).
+  std::optional<FreqEntry> FEOpt = Pll->getFSB(getSMB());
+  if (!FEOpt) {
+    // Don't trust the cache next time.
+    if (Cache) {
+      DiscoveryCache::remove(DiscoveryCache::DefaultFile);
+      Cache.reset();
+    }
+    return std::nullopt;
+  }
+  if (Cache && (Cache->PLL != Pll->getName() ||
+                Cache->PLLAddr != Pll->getAddr() ||
+                Cache->PLLBlock != Pll->getLastBlock())) {
+    Cache->PLL = Pll->getName();
+    Cache->PLLAddr = Pll->getAddr();
+    Cache->PLLBlock = Pll->getLastBlock();
+    saveCache();
+  }
+  return FEOpt;
+}
+
+bool Session::setFrequency(const FreqEntry &FE,
+                           std::optional<unsigned> RampDwellMillis) {
+  SMBus &SMB = getSMB();
+  if (!RampDwellMillis) {
+    // Only read the current frequency if we may have a settle time for it.
+    std::optional<FreqEntry> Current;
+    if (!Settle.empty())
+      Current = getFrequency();
+    if (!Pll->setFSB(FE, SMB)) {
+      std::cerr << "Error setting FSB: " << FE << '\n';
+      return false;
+    }
+    if (Current)
+      if (auto Wait = Settle.getWaitMillis(Pll->getName(), *Current, FE))
+        delay(*Wait);
+    return true;
+  }
+  std::optional<FreqEntry> Current = getFrequency();
+  if (!Current)
+    return false;
+  std::vector<FreqEntry> Path = Pll->getRampPath(*Current, FE);
+  Path.push_back(FE);
+  {
+    DecimalGuard DG(std::cout);
+    std::cout << "Ramping in " << Path.size() << " steps, dwell "
+              << *RampDwellMillis << "ms" << '\n';
+  }
+  FreqEntry Prev = *Current;
+  for (const FreqEntry &Step : Path) {
+    PhaseTimer StepPhase("ramp-step");
+    // Flush, in case the machine hangs at this step.
+    std::cout << "Ramp step: " << Step << std::endl;
+    if (!Pll->setFSB(Step, SMB)) {
+      std::cerr << "Error setting FSB: " << Step << '\n';
+      return false;
+    }
+    auto Wait = Settle.getWaitMillis(Pll->getName(), Prev, Step);
+    if (Wait && isDebug()) {
+      DecimalGuard DG(std::cout);
+      std::cout << "Measured settle wait: " << *Wait << "ms" << '\n';
+    }
+    delay(Wait ? *Wait : *RampDwellMillis);
+    Prev = Step;
+    std::optional<FreqEntry> FEOpt = Pll->getFSB(SMB);
+    if (!FEOpt || !FEOpt->isExactly(Step)) {
+      std::cerr << "Ramp step did not stick, stopping at: ";
+      if (FEOpt)
+        std::cerr << *FEOpt;
+      std::cerr << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<FreqEntry> Session::listFrequencies() const {
+  return Pll->getFrequencies();
+}
@@ -0,0 +1,77 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// The library interface. A Session does the hardware discovery once and then
+// every query is just the SMBus transactions it needs. The command line tool
+// is one client, sisfsb_api.h wraps it for C.
+//
+
+#ifndef __SRC_SESSION_H__
+#define __SRC_SESSION_H__
+
+#include "cache.h"
+#include "chips.h"
+#include "freqentry.h"
+#include "settle.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class Session {
+  Chips AllChips;
+  HostToPCIBridge *HostBridge = nullptr;
+  PLL *Pll = nullptr;
+  /// Use and update the discovery cache.
+  bool UseCache;
+  std::optional<DiscoveryCache> Cache;
+  HWFingerprint Fingerprint;
+  /// If set, used instead of the host bridge SMBus.
+  std::unique_ptr<SMBus> SimSMB;
+  /// The measured settle times of the PLL transitions.
+  SettleTable Settle;
+
+  void saveCache();
+
+public:
+  Session(bool UseCache = true) : UseCache(UseCache) {}
+
+  /// Finds a supported host bridge, from the cache if possible. \Returns
+  /// false on error.
+  bool findHostBridge();
+  /// Initializes the SMBus of the host bridge. \Returns false on error.
+  bool initSMB();
+  /// Does both of the above.
+  bool discover() { return findHostBridge() && initSMB(); }
+  /// Uses \p SMB (e.g. a SimSMBus) instead of discovering the hardware.
+  void simulate(std::unique_ptr<SMBus> SMB) {
+    SimSMB = std::move(SMB);
+    UseCache = false;
+  }
+  /// Looks up the PLL named \p PLLName, or detects it if it is PLL::AutoStr,
+  /// and checks that it responds. Needs the SMBus. \Returns false on error.
+  bool attachPLL(const std::string &PLLName);
+
+  Chips &getChips() { return AllChips; }
+  bool hasHostBridge() const { return HostBridge != nullptr; }
+  HostToPCIBridge &getHostBridge() { return *HostBridge; }
+  SMBus &getSMB() { return SimSMB ? *SimSMB : HostBridge->getSMB(); }
+  bool hasPLL() const { return Pll != nullptr; }
+  PLL &getPLL() { return *Pll; }
+
+  /// \Returns the current FSB/SDRAM/PCI frequencies from the PLL.
+  std::optional<FreqEntry> getFrequency();
+  /// Waits the settle times in \p T after each PLL switch that it has.
+  void setSettleTable(SettleTable T) { Settle = std::move(T); }
+  /// Programs the PLL with \p FE. If \p RampDwellMillis is set, ramps there
+  /// through the intermediate frequencies, waiting this long after each step
+  /// (or the measured settle time if known) and checking that it stuck.
+  /// \Returns false on error.
+  bool setFrequency(const FreqEntry &FE,
+                    std::optional<unsigned> RampDwellMillis = std::nullopt);
+  /// \Returns the frequencies that the PLL supports.
+  std::vector<FreqEntry> listFrequencies() const;
+};
+
+#endif // __SRC_SESSION_H__
@@ -0,0 +1,198 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "settle.h"
+#include "chips.h"
+#include "cpu.h"
+#include "smbus.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/// Writes \p FE as FSB/SDRAM/PCI, the way FreqEntry parses it.
+static void writeFreq(std::ostream &OS, const FreqEntry &FE) {
+  DecimalGuard DG(OS);
+  OS << std::fixed << std::setprecision(1) << FE.getFsb() << "/"
+     << FE.getSdram() << "/" << FE.getPci();
+}
+
+void SettleEntry::print(std::ostream &OS) const {
+  DecimalGuard DG(OS);
+  OS << PLLName << " ";
+  writeFreq(OS, From);
+  OS << " -> ";
+  writeFreq(OS, To);
+  OS << ": " << SettleMicros << "us, overshoot " << std::fixed
+     << std::setprecision(1) << OvershootPct << "%";
+}
+
+std::optional<SettleTable> SettleTable::load(const std::string &Path) {
+  SettleTable T;
+  std::ifstream IS(Path);
+  if (!IS)
+    return T;
+  std::string Line;
+  for (unsigned LineNo = 1; std::getline(IS, Line); ++LineNo) {
+    if (Line.empty() || Line[0] == '#')
+      continue;
+    std::istringstream SS(Line);
+    std::string FromStr, ToStr;
+    SettleEntry E;
+    if (!(SS >> E.PLLName >> FromStr >> ToStr >> E.SettleMicros >>
+          E.OvershootPct)) {
+      std::cerr << Path << ":" << LineNo << ": expected <PLL> <From> <To> "
+                << "<SettleMicros> <OvershootPct>" << '\n';
+      return std::nullopt;
+    }
+    E.From = FreqEntry(FromStr);
+    E.To = FreqEntry(ToStr);
+    if (E.From.bad() || E.To.bad()) {
+      std::cerr << Path << ":" << LineNo << ": bad frequencies" << '\n';
+      return std::nullopt;
+    }
+    T.add(E);
+  }
+  return T;
+}
+
+bool SettleTable::save(const std::string &Path) const {
+  std::ofstream OS(Path);
+  OS << "# PLL From To SettleMicros OvershootPct, written by sisfsb -settle\n";
+  for (const SettleEntry &E : Entries) {
+    OS << E.PLLName << " ";
+    writeFreq(OS, E.From);
+    OS << " ";
+    writeFreq(OS, E.To);
+    OS << " " << E.SettleMicros << " " << std::fixed << std::setprecision(1)
+       << E.OvershootPct << "\n";
+  }
+  if (!OS) {
+    std::cerr << "Failed to write " << Path << '\n';
+    return false;
+  }
+  return true;
+}
+
+void SettleTable::add(const SettleEntry &E) {
+  auto It = std::find_if(
+      Entries.begin(), Entries.end(), [&E](const SettleEntry &Other) {
+        return toLower(Other.PLLName) == toLower(E.PLLName) &&
+               Other.From.isExactly(E.From) && Other.To.isExactly(E.To);
+      });
+  if (It != Entries.end())
+    *It = E;
+  else
+    Entries.push_back(E);
+}
+
+const SettleEntry *SettleTable::find(const std::string &PLLName,
+                                     const FreqEntry &From,
+                                     const FreqEntry &To) const {
+  for (const SettleEntry &E : Entries)
+    if (toLower(E.PLLName) == toLower(PLLName) && E.From.isExactly(From) &&
+        E.To.isExactly(To))
+      return &E;
+  return nullptr;
+}
+
+std::optional<unsigned>
+SettleTable::getWaitMillis(const std::string &PLLName, const FreqEntry &From,
+                           const FreqEntry &To) const {
+  const SettleEntry *E = find(PLLName, From, To);
+  if (E == nullptr)
+    return std::nullopt;
+  // Round up, a switch is never free.
+  return (E->SettleMicros * SafetyFactor + 999) / 1000 + 1;
+}
+
+double SettleMeter::sampleRate() {
+  uint64_t StartRef = RefMicros();
+  uint64_t StartTicks = Ticks();
+  uint64_t EndRef;
+  do
+    EndRef = RefMicros();
+  while (EndRef - StartRef < WindowMicros);
+  return (double)(Ticks() - StartTicks) / (EndRef - StartRef);
+}
+
+std::optional<SettleMeter> SettleMeter::getTSCMeter() {
+  if (!CPU::hasFeatures(CPU::TSCMask)) {
+    std::cerr << "No TSC, can't measure the CPU clock" << '\n';
+    return std::nullopt;
+  }
+  if (CPU::hasInvariantTSC()) {
+    std::cerr << "The TSC runs at a constant rate, it can't see the FSB change"
+              << '\n';
+    return std::nullopt;
+  }
+  return SettleMeter(CPU::rdtsc);
+}
+
+std::optional<SettleEntry> SettleMeter::measure(PLL &Pll, SMBus &SMB,
+                                                const FreqEntry &From,
+                                                const FreqEntry &To) {
+  // With the I2C selection enabled up front the key write alone switches the
+  // clock, so nothing else has to go on the bus once we start sampling.
+  if (!Pll.setEnabled(true, SMB))
+    return std::nullopt;
+  std::vector<uint8_t> Block = Pll.getFSBBlock(To, SMB);
+  if (Block.empty())
+    return std::nullopt;
+  double OldRate = 0.0;
+  for (unsigned Cnt = 0; Cnt != BaselineWindows; ++Cnt)
+    OldRate += sampleRate();
+  OldRate /= BaselineWindows;
+  // The multiplier is fixed, so the core clock scales with the FSB.
+  double Target = OldRate * To.getFsb() / From.getFsb();
+  double Dir = To.getFsb() >= From.getFsb() ? 1.0 : -1.0;
+
+  // Time from just before the key write. The blocking writeBlockData() sleeps
+  // 100ms after starting the transfer, so step the request instead, which
+  // returns as soon as the controller is done with it.
+  SMBusRequest Req{SMBusRequest::Op::WriteBlockData, Pll.getAddr(), PLL::Cmd,
+                   Block};
+  uint64_t Start = RefMicros();
+  while (!Req.isFinished())
+    SMB.step(Req);
+  if (!Req.ok()) {
+    std::cerr << "Failed to write block data to PLL" << '\n';
+    return std::nullopt;
+  }
+
+  SettleEntry E;
+  E.PLLName = Pll.getName();
+  E.From = From;
+  E.To = To;
+  double Overshoot = 0.0;
+  unsigned Stable = 0;
+  uint64_t StableSince = 0;
+  while (Stable != StableWindows) {
+    uint64_t WindowStart = RefMicros() - Start;
+    if (WindowStart > MaxSettleMicros) {
+      DecimalGuard DG(std::cerr);
+      std::cerr << "The clock did not settle within " << MaxSettleMicros
+                << "us" << '\n';
+      return std::nullopt;
+    }
+    double Rate = sampleRate();
+    double DevPct = (Rate - Target) / Target * 100.0;
+    Overshoot = std::max(Overshoot, Dir * DevPct);
+    if (isDebug()) {
+      DecimalGuard DG(std::cout);
+      std::cout << "  " << WindowStart << "us " << Rate << "MHz\n";
+    }
+    if (std::fabs(DevPct) > TolerancePct) {
+      Stable = 0;
+      continue;
+    }
+    if (Stable++ == 0)
+      StableSince = WindowStart;
+  }
+  E.SettleMicros = StableSince;
+  E.OvershootPct = Overshoot;
+  return E;
+}
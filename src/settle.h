@@ -0,0 +1,103 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// How long the CPU clock takes to settle after a PLL switch. SettleMeter
+// measures it by sampling the TSC rate against a reference clock, and
+// SettleTable keeps the results per transition in a text file, so that the
+// switch code can wait just as long as needed.
+//
+
+#ifndef __SRC_SETTLE_H__
+#define __SRC_SETTLE_H__
+
+#include "freqentry.h"
+#include "utils.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+class PLL;
+class SMBus;
+
+/// The measured settle time of one PLL transition.
+struct SettleEntry {
+  std::string PLLName;
+  FreqEntry From;
+  FreqEntry To;
+  /// From the PLL write until the CPU clock stayed close to the target.
+  uint32_t SettleMicros = 0;
+  /// How far the clock went past the target, in % of the target.
+  float OvershootPct = 0.0;
+
+  void print(std::ostream &OS) const;
+};
+
+class SettleTable {
+  std::vector<SettleEntry> Entries;
+
+public:
+  /// DOS 8.3 file name, in the current directory.
+  static constexpr const char *DefaultFile = "SISFSB.SET";
+  /// We wait this many times the measured settle time.
+  static constexpr const unsigned SafetyFactor = 2;
+
+  /// Loads the table from \p Path. \Returns an empty table if the file does
+  /// not exist, or nullopt if it can't be parsed.
+  static std::optional<SettleTable> load(const std::string &Path);
+  /// Writes the table to \p Path. \Returns false on error.
+  bool save(const std::string &Path) const;
+  /// Adds \p E, replacing the entry for the same transition if any.
+  void add(const SettleEntry &E);
+  /// \Returns the entry for \p From to \p To on \p PLLName, or null.
+  const SettleEntry *find(const std::string &PLLName, const FreqEntry &From,
+                          const FreqEntry &To) const;
+  /// \Returns how long to wait after switching from \p From to \p To, or
+  /// nullopt if it was not measured.
+  std::optional<unsigned> getWaitMillis(const std::string &PLLName,
+                                        const FreqEntry &From,
+                                        const FreqEntry &To) const;
+  bool empty() const { return Entries.empty(); }
+  size_t size() const { return Entries.size(); }
+};
+
+class SettleMeter {
+public:
+  /// The length of each rate sample.
+  static constexpr const unsigned WindowMicros = 100;
+  /// The number of samples averaged for the rate before the switch.
+  static constexpr const unsigned BaselineWindows = 20;
+  /// The clock has settled once this many samples in a row are within
+  /// TolerancePct of the target.
+  static constexpr const unsigned StableWindows = 8;
+  static constexpr const float TolerancePct = 0.5;
+  /// Give up if it has not settled by then.
+  static constexpr const unsigned MaxSettleMicros = 500000;
+
+private:
+  std::function<uint64_t()> Ticks;
+  std::function<uint64_t()> RefMicros;
+
+  /// \Returns the tick rate in MHz over one window.
+  double sampleRate();
+
+public:
+  /// Counts the CPU clock with \p Ticks against \p RefMicros.
+  SettleMeter(std::function<uint64_t()> Ticks,
+              std::function<uint64_t()> RefMicros = getMicros)
+      : Ticks(Ticks), RefMicros(RefMicros) {}
+  /// \Returns a meter on the TSC, or nullopt and prints why if the TSC
+  /// can't follow the core clock.
+  static std::optional<SettleMeter> getTSCMeter();
+  /// Switches \p Pll on \p SMB from \p From to \p To and measures how long
+  /// the CPU clock takes to settle. \Returns nullopt if the switch failed or
+  /// the clock did not settle.
+  std::optional<SettleEntry> measure(PLL &Pll, SMBus &SMB,
+                                     const FreqEntry &From,
+                                     const FreqEntry &To);
+};
+
+#endif // __SRC_SETTLE_H__
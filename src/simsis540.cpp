@@ -0,0 +1,180 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "simsis540.h"
+#include <algorithm>
+
+SimSiS540::SimSiS540() {
+  Bus.Counting = false;
+  constexpr uint16_t SiSVendorID = 0x1039;
+  ConfigSpace &Host = addFunction(BDF(0, 0, 0), SiSVendorID, 0x0540);
+  // Class 06:00 (host bridge).
+  Host[PCI::ClassReg] = 0x06;
+  ConfigSpace &LPC = addFunction(BDF(0, 1, 0), SiSVendorID, 0x0008);
+  // Class 06:01 (ISA bridge).
+  LPC[PCI::SubClassReg] = 0x01;
+  LPC[PCI::ClassReg] = 0x06;
+  LPC[LPC_ACPIBaseAddrReg] = ACPIBase & 0xff;
+  LPC[LPC_ACPIBaseAddrReg + 1] = ACPIBase >> 8;
+}
+
+SimSiS540::ConfigSpace &SimSiS540::addFunction(const BDF &Addr,
+                                               uint16_t VendorID,
+                                               uint16_t DeviceID) {
+  ConfigSpace &Regs = Config[Addr.getAddr()];
+  Regs.fill(0);
+  Regs[PCI::VendorIdReg] = VendorID & 0xff;
+  Regs[PCI::VendorIdReg + 1] = VendorID >> 8;
+  Regs[PCI::DeviceIdReg] = DeviceID & 0xff;
+  Regs[PCI::DeviceIdReg + 1] = DeviceID >> 8;
+  return Regs;
+}
+
+bool SimSiS540::isACPIEnabled() {
+  return Config[BDF(0, 1, 0).getAddr()][LPC_BiosCtrlReg] & LPC_EnableACPIMask;
+}
+
+uint16_t SimSiS540::getACPIBase() {
+  ConfigSpace &LPC = Config[BDF(0, 1, 0).getAddr()];
+  return LPC[LPC_ACPIBaseAddrReg] | LPC[LPC_ACPIBaseAddrReg + 1] << 8;
+}
+
+uint32_t SimSiS540::configIn(unsigned Offset, unsigned Width) {
+  auto It = Config.find(ConfigAddr & ~0xffu);
+  // Nobody answers, so the bus floats high.
+  if (It == Config.end())
+    return Width == 4 ? 0xffffffff : (1u << (Width * 8)) - 1;
+  unsigned Reg = (ConfigAddr & 0xfc) + Offset;
+  uint32_t Val = 0;
+  for (unsigned Idx = 0; Idx != Width; ++Idx)
+    Val |= (uint32_t)It->second[(Reg + Idx) & 0xff] << (Idx * 8);
+  return Val;
+}
+
+void SimSiS540::configOut(unsigned Offset, unsigned Width, uint32_t Val) {
+  auto It = Config.find(ConfigAddr & ~0xffu);
+  if (It == Config.end())
+    return;
+  unsigned Reg = (ConfigAddr & 0xfc) + Offset;
+  for (unsigned Idx = 0; Idx != Width; ++Idx, Val >>= 8)
+    // The vendor and device IDs are read-only.
+    if (((Reg + Idx) & 0xff) >= 4)
+      It->second[(Reg + Idx) & 0xff] = Val & 0xff;
+}
+
+void SimSiS540::loadBlockData() {
+  for (unsigned Idx = 0; Idx != 8; ++Idx) {
+    size_t Pos = BlockOffset + Idx;
+    getSMBReg(SMB_BYTE0_7 + Idx) = Pos < Block.size() ? Block[Pos] : 0;
+  }
+}
+
+void SimSiS540::startTransfer(uint8_t Ty) {
+  uint8_t AddrReg = getSMBReg(SMB_ADDR);
+  uint8_t Addr = AddrReg >> 1;
+  bool Read = AddrReg & 0x01;
+  uint8_t Cmd = getSMBReg(SMB_CMD);
+  uint8_t &Data0 = getSMBReg(SMB_BYTE0_7);
+  uint8_t &Data1 = getSMBReg(SMB_BYTE0_7 + 1);
+  bool Ok = false;
+  switch (Ty) {
+  case Quick:
+    Ok = Read ? Bus.readQuick(Addr) : Bus.writeQuick(Addr);
+    break;
+  case Byte:
+    if (!Read) {
+      Ok = Bus.writeByte(Addr, Cmd);
+    } else if (auto Val = Bus.readByte(Addr)) {
+      Data0 = *Val;
+      Ok = true;
+    }
+    break;
+  case ByteData:
+    if (!Read) {
+      Ok = Bus.writeByteData(Addr, Cmd, Data0);
+    } else if (auto Val = Bus.readByteData(Addr, Cmd)) {
+      Data0 = *Val;
+      Ok = true;
+    }
+    break;
+  case WordData:
+    // SimSMBus has no word writes, so those are NACKed.
+    if (!Read)
+      break;
+    if (auto Val = Bus.readWordData(Addr, Cmd)) {
+      Data0 = *Val & 0xff;
+      Data1 = *Val >> 8;
+      Ok = true;
+    }
+    break;
+  case BlockData:
+    if (!Read) {
+      uint8_t Count = getSMBReg(SMB_COUNT);
+      auto Begin = SMBRegs.begin() + (SMB_BYTE0_7 - SMB_STS);
+      Ok = Count != 0 && Count <= 8 &&
+           Bus.writeBlockData(Addr, Cmd, std::vector<uint8_t>(Begin, Begin + Count));
+      break;
+    }
+    Block = Bus.readBlockData(Addr, Cmd);
+    Block.resize(std::min(Block.size(), (size_t)32));
+    Ok = !Block.empty();
+    getSMBReg(SMB_COUNT) = Block.size();
+    BlockOffset = 0;
+    loadBlockData();
+    if (Ok)
+      getSMBReg(SMB_STS) |= BlockFinishedMask;
+    break;
+  }
+  getSMBReg(SMB_STS) |= Ok ? TrCompleteMask : DevErrMask;
+}
+
+uint32_t SimSiS540::in(uint16_t Port, unsigned Width) {
+  if (Port == PCI::PCI_CONFIG_ADDR && Width == 4)
+    return ConfigAddr;
+  if (Port >= PCI::PCI_CONFIG_DATA && Port < PCI::PCI_CONFIG_DATA + 4)
+    return configIn(Port - PCI::PCI_CONFIG_DATA, Width);
+  uint16_t Base = getACPIBase();
+  if (isACPIEnabled() && Width == 1 && Port >= Base + SMB_STS &&
+      Port < Base + SMB_STS + NumSMBRegs)
+    return getSMBReg(Port - Base);
+  // Nothing decodes the port.
+  return Width == 4 ? 0xffffffff : 0xff;
+}
+
+void SimSiS540::out(uint16_t Port, unsigned Width, uint32_t Val) {
+  if (Port == PCI::PCI_CONFIG_ADDR && Width == 4) {
+    ConfigAddr = Val;
+    return;
+  }
+  if (Port >= PCI::PCI_CONFIG_DATA && Port < PCI::PCI_CONFIG_DATA + 4) {
+    configOut(Port - PCI::PCI_CONFIG_DATA, Width, Val);
+    return;
+  }
+  uint16_t Base = getACPIBase();
+  if (!isACPIEnabled() || Width != 1 || Port < Base + SMB_STS ||
+      Port >= Base + SMB_STS + NumSMBRegs)
+    return;
+  uint8_t Reg = Port - Base;
+  switch (Reg) {
+  case SMB_STS:
+    // The status bits are cleared by writing 1.
+    getSMBReg(SMB_STS) &= ~Val;
+    // Acknowledging a full FIFO brings in the next 8 bytes.
+    if ((Val & BlockFinishedMask) && BlockOffset + 8 < Block.size()) {
+      BlockOffset += 8;
+      loadBlockData();
+      getSMBReg(SMB_STS) |= BlockFinishedMask;
+    }
+    return;
+  case SMB_HOST_CNT:
+    getSMBReg(SMB_HOST_CNT) = Val & ~(StartTransferMask | KillMask);
+    if (Val & StartTransferMask)
+      startTransfer(Val & TransferTyMask);
+    return;
+  default:
+    getSMBReg(Reg) = Val;
+    return;
+  }
+}
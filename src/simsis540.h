@@ -0,0 +1,97 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// A simulated SiS540 board behind PortIO: the PCI configuration mechanism at
+// 0xcf8/0xcfc with the host bridge and the LPC bridge, and the SMBus host
+// controller in the ACPI I/O space with a SimSMBus behind it. Unlike a bare
+// SimSMBus, it runs the real discovery and SiSSMBus code, so -io-budget sees
+// every PCI and port access that they make.
+//
+
+#ifndef __SRC_SIMSIS540_H__
+#define __SRC_SIMSIS540_H__
+
+#include "pci.h"
+#include "portio.h"
+#include "simsmbus.h"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class SimSiS540 final : public PortIOHook {
+  using ConfigSpace = std::array<uint8_t, 256>;
+
+  // The LPC registers that the discovery uses.
+  static constexpr const uint8_t LPC_BiosCtrlReg = 0x40;
+  static constexpr const uint8_t LPC_EnableACPIMask = 0x80;
+  static constexpr const uint8_t LPC_ACPIBaseAddrReg = 0x74;
+
+  // The SMBus registers, from the ACPI I/O base.
+  static constexpr const uint8_t SMB_STS = 0x80;
+  static constexpr const uint8_t SMB_HOST_CNT = 0x83;
+  static constexpr const uint8_t SMB_ADDR = 0x84;
+  static constexpr const uint8_t SMB_CMD = 0x85;
+  static constexpr const uint8_t SMB_COUNT = 0x87;
+  static constexpr const uint8_t SMB_BYTE0_7 = 0x88;
+  static constexpr const uint8_t NumSMBRegs = 0x14;
+
+  // Masks for SMB_STS
+  static constexpr const uint8_t DevErrMask = 0x02;
+  static constexpr const uint8_t TrCompleteMask = 0x08;
+  static constexpr const uint8_t BlockFinishedMask = 0x10;
+
+  // Masks for SMB_HOST_CNT
+  static constexpr const uint8_t TransferTyMask = 0x07;
+  static constexpr const uint8_t StartTransferMask = 0x10;
+  static constexpr const uint8_t KillMask = 0x20;
+
+  enum TransferTy : uint8_t {
+    Quick = 0b000,
+    Byte = 0b001,
+    ByteData = 0b010,
+    WordData = 0b011,
+    BlockData = 0b101,
+  };
+
+  /// The configuration space of each function, by BDF::getAddr().
+  std::map<uint32_t, ConfigSpace> Config;
+  /// The last value written to PCI_CONFIG_ADDR.
+  uint32_t ConfigAddr = 0;
+  /// The SMBus registers, from SMB_STS. Transactions complete as soon as
+  /// they start, so the controller is never busy.
+  std::array<uint8_t, NumSMBRegs> SMBRegs = {};
+  /// The result of the last block read, which the host drains 8 bytes at a
+  /// time through SMB_BYTE0_7.
+  std::vector<uint8_t> Block;
+  size_t BlockOffset = 0;
+
+  ConfigSpace &addFunction(const BDF &Addr, uint16_t VendorID,
+                           uint16_t DeviceID);
+  uint8_t &getSMBReg(uint8_t Reg) { return SMBRegs[Reg - SMB_STS]; }
+  /// \Returns true if the LPC decodes the ACPI I/O space.
+  bool isACPIEnabled();
+  uint16_t getACPIBase();
+  uint32_t configIn(unsigned Offset, unsigned Width);
+  void configOut(unsigned Offset, unsigned Width, uint32_t Val);
+  /// Copies the next 8 bytes of Block into SMB_BYTE0_7.
+  void loadBlockData();
+  /// Runs the transaction that the registers describe on Bus.
+  void startTransfer(uint8_t Ty);
+
+public:
+  /// Where the BIOS put the ACPI I/O space.
+  static constexpr const uint16_t ACPIBase = 0x5000;
+  /// The devices on the SMBus. Its transactions are not counted, SiSSMBus
+  /// counts them already.
+  SimSMBus Bus;
+
+  /// A board straight from the BIOS, with the ACPI I/O space disabled.
+  SimSiS540();
+  uint32_t in(uint16_t Port, unsigned Width) override;
+  void out(uint16_t Port, unsigned Width, uint32_t Val) override;
+  bool finish() override { return true; }
+};
+
+#endif // __SRC_SIMSIS540_H__
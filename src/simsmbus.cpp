@@ -0,0 +1,99 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "simsmbus.h"
+#include <sstream>
+
+std::vector<uint8_t> *SimSMBus::getDevice(uint8_t Addr, const char *Op,
+                                          std::optional<uint8_t> Cmd) {
+  if (Counting)
+    ++Transactions;
+  if (Tracing) {
+    std::ostringstream SS;
+    SS << std::hex << Op << "(0x" << (int)Addr;
+    if (Cmd)
+      SS << ", 0x" << (int)*Cmd;
+    SS << ")";
+    Trace.push_back(SS.str());
+  }
+  auto It = Devices.find(Addr);
+  if (It == Devices.end()) {
+    // NACKed after the address byte.
+    addWireTime(1);
+    return nullptr;
+  }
+  return &It->second;
+}
+
+bool SimSMBus::probe(uint8_t Addr, bool Read) {
+  if (getDevice(Addr, Read ? "readQuick" : "writeQuick") == nullptr)
+    return false;
+  addWireTime(1);
+  return true;
+}
+
+std::optional<uint8_t> SimSMBus::readByte(uint8_t Addr) {
+  auto *Regs = getDevice(Addr, "readByte");
+  if (Regs == nullptr || Regs->empty())
+    return std::nullopt;
+  addWireTime(2);
+  return (*Regs)[0];
+}
+
+bool SimSMBus::writeByte(uint8_t Addr, uint8_t Cmd) {
+  if (getDevice(Addr, "writeByte", Cmd) == nullptr)
+    return false;
+  addWireTime(2);
+  return true;
+}
+
+std::optional<uint8_t> SimSMBus::readByteData(uint8_t Addr, uint8_t Cmd) {
+  auto *Regs = getDevice(Addr, "readByteData", Cmd);
+  if (Regs == nullptr || Cmd >= Regs->size())
+    return std::nullopt;
+  // With a repeated start and the address again.
+  addWireTime(4);
+  return (*Regs)[Cmd];
+}
+
+bool SimSMBus::writeByteData(uint8_t Addr, uint8_t Cmd, uint8_t Val) {
+  auto *Regs = getDevice(Addr, "writeByteData", Cmd);
+  if (Regs == nullptr || Cmd >= Regs->size())
+    return false;
+  addWireTime(3);
+  (*Regs)[Cmd] = Val;
+  return true;
+}
+
+std::optional<uint16_t> SimSMBus::readWordData(uint8_t Addr, uint8_t Cmd) {
+  auto *Regs = getDevice(Addr, "readWordData", Cmd);
+  if (Regs == nullptr || Cmd + 1u >= Regs->size())
+    return std::nullopt;
+  addWireTime(5);
+  return (*Regs)[Cmd] | (*Regs)[Cmd + 1] << 8;
+}
+
+std::vector<uint8_t> SimSMBus::readBlockData(uint8_t Addr, uint8_t Cmd) {
+  auto *Regs = getDevice(Addr, "readBlockData", Cmd);
+  if (Regs == nullptr || Cmd >= Regs->size())
+    return {};
+  // The address twice, the command, the count and the data.
+  addWireTime(4 + Regs->size() - Cmd);
+  return std::vector<uint8_t>(Regs->begin() + Cmd, Regs->end());
+}
+
+bool SimSMBus::writeBlockData(uint8_t Addr, uint8_t Cmd,
+                              const std::vector<uint8_t> Data) {
+  auto *Regs = getDevice(Addr, "writeBlockData", Cmd);
+  if (Regs == nullptr || Cmd + Data.size() > Regs->size())
+    return false;
+  addWireTime(3 + Data.size());
+  std::copy(Data.begin(), Data.end(), Regs->begin() + Cmd);
+  return true;
+}
+
+void SimSMBus::print(std::ostream &OS) const {
+  OS << Name << " with " << Devices.size() << " device(s)";
+}
@@ -0,0 +1,68 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// An SMBus with simulated devices, for trying things out without the
+// hardware (e.g. the governor on a Linux box).
+//
+
+#ifndef __SRC_SIMSMBUS_H__
+#define __SRC_SIMSMBUS_H__
+
+#include "smbus.h"
+#include <map>
+#include <optional>
+#include <string>
+
+class SimSMBus final : public SMBus {
+  /// The register file of each device.
+  std::map<uint8_t, std::vector<uint8_t>> Devices;
+
+  /// Counts a transaction of kind \p Op, adding it to the trace if enabled.
+  /// \Returns the registers of the device at \p Addr, or null if none.
+  std::vector<uint8_t> *getDevice(uint8_t Addr, const char *Op,
+                                  std::optional<uint8_t> Cmd = std::nullopt);
+  /// Adds the time \p Bytes (including the address bytes) take on the wire.
+  void addWireTime(unsigned Bytes) {
+    // 9 clocks per byte with the ACK, plus the start and stop conditions.
+    SimMicros += (Bytes * 9 + 2) * BitMicros;
+  }
+
+public:
+  /// The number of registers of a simulated PLL, enough for a block read.
+  static constexpr const unsigned PLLRegs = 8;
+  /// The time of one SMBus clock at 100KHz.
+  static constexpr const unsigned BitMicros = 10;
+  /// The time all transactions would have taken on a real bus.
+  uint64_t SimMicros = 0;
+  /// If disabled, the transactions don't add to SMBus::Transactions, e.g.
+  /// because a simulated controller in front of us counts them already.
+  bool Counting = true;
+  /// If enabled, each transaction is appended as "op(addr[, cmd])".
+  bool Tracing = false;
+  std::vector<std::string> Trace;
+
+  SimSMBus() : SMBus("SimSMBus", /*BaseAddr=*/0) {}
+  /// Adds a device at \p Addr with registers \p Regs. Block reads return all
+  /// registers from Cmd to the end.
+  void addDevice(uint8_t Addr, const std::vector<uint8_t> &Regs) {
+    Devices[Addr] = Regs;
+  }
+  /// \Returns the registers of the device at \p Addr.
+  const std::vector<uint8_t> &getRegs(uint8_t Addr) { return Devices[Addr]; }
+
+  bool probe(uint8_t Addr, bool Read) override;
+  bool readQuick(uint8_t Addr) override { return probe(Addr, true); }
+  bool writeQuick(uint8_t Addr) override { return probe(Addr, false); }
+  std::optional<uint8_t> readByte(uint8_t Addr) override;
+  bool writeByte(uint8_t Addr, uint8_t Cmd) override;
+  std::optional<uint8_t> readByteData(uint8_t Addr, uint8_t Cmd) override;
+  bool writeByteData(uint8_t Addr, uint8_t Cmd, uint8_t Val) override;
+  std::optional<uint16_t> readWordData(uint8_t Addr, uint8_t Cmd) override;
+  std::vector<uint8_t> readBlockData(uint8_t Addr, uint8_t Cmd) override;
+  bool writeBlockData(uint8_t Addr, uint8_t Cmd,
+                      const std::vector<uint8_t> Data) override;
+  void print(std::ostream &OS) const override;
+};
+
+#endif // __SRC_SIMSMBUS_H__
@@ -5,68 +5,496 @@
 
 #include "sisfsb.h"
 #include "chips.h"
+#include "governor.h"
+#include "hwmon.h"
+#include "iobudget.h"
+#include "mnpllcheck.h"
+#include "mtrr.h"
 #include "pci.h"
+#include "pcitune.h"
+#include "script.h"
+#include "settle.h"
+#include "simsmbus.h"
+#include "snapshot.h"
+#include "spd.h"
+#include "stress.h"
+#include "timing.h"
+
+void SiSFSB::scanSMBus(SMBus &SMB) {
+  std::cout << "Scanning SMBus 0x" << (int)SMBus::MinAddr << "-0x"
+            << (int)SMBus::MaxAddr << '\n';
+  std::vector<uint8_t> Found = SMB.scan();
+  for (uint8_t Addr : Found)
+    std::cout << "  0x" << std::setw(2) << std::setfill('0') << (int)Addr
+              << std::setfill(' ') << " " << SMBus::getDeviceClass(Addr)
+              << '\n';
+  DecimalGuard DG(std::cout);
+  std::cout << Found.size() << " device(s) found" << '\n';
+}
+
+void SiSFSB::showSPD(SMBus &SMB) {
+  std::vector<SPD> SPDs = SPD::findAll(SMB);
+  if (SPDs.empty()) {
+    std::cout << "No SPD EEPROMs found" << '\n';
+    return;
+  }
+  for (SPD &S : SPDs) {
+    S.print(std::cout);
+    if (isDebug())
+      S.dump(std::cout);
+  }
+  if (auto Limit = SPD::getMaxSdramMHz(SPDs)) {
+    DecimalGuard DG(std::cout);
+    std::cout << "SDRAM limit: " << *Limit << "MHz" << '\n';
+  }
+}
+
+bool SiSFSB::showDRAM(HostToPCIBridge &HB) {
+  const auto &Fields = HB.getDRAMTimings();
+  if (Fields.empty()) {
+    std::cerr << "No DRAM timings known for " << HB.getName() << '\n';
+    return false;
+  }
+  DecimalGuard DG(std::cout);
+  std::cout << "DRAM timings:" << '\n';
+  for (const DRAMTimingField &Field : Fields) {
+    std::cout << "  " << std::setw(14) << std::left << Field.Name << std::right
+              << " ";
+    if (auto Val = Field.read(HB.getBDF()))
+      std::cout << *Val << Field.getUnit() << '\n';
+    else
+      std::cout << "unknown" << '\n';
+  }
+  return true;
+}
+
+bool SiSFSB::chipsetOpt(HostToPCIBridge &HB) {
+  const auto &Features = HB.getChipsetFeatures();
+  if (Features.empty()) {
+    std::cerr << "No chipset features known for " << HB.getName() << '\n';
+    return false;
+  }
+  const std::string &Cmd = Args.ChipsetOpt;
+  if (Cmd == "list") {
+    for (const ChipsetFeature &Feature : Features) {
+      Feature.print(std::cout);
+      std::cout << '\n';
+    }
+    return true;
+  }
+  auto Show = [&HB, &Features]() {
+    for (const ChipsetFeature &Feature : Features)
+      std::cout << "  " << std::setw(22) << std::left << Feature.Name
+                << std::right << " "
+                << (Feature.isEnabled(HB.getBDF()) ? "enabled" : "disabled")
+                << '\n';
+  };
+  if (Cmd == "show") {
+    Show();
+    return true;
+  }
+  bool Success = true;
+  if (Cmd == "profile") {
+    unsigned NumSafe = 0;
+    for (const ChipsetFeature &Feature : Features) {
+      if (!Feature.Safe)
+        continue;
+      std::cout << "Enabling " << Feature.Name << '\n';
+      Success &= Feature.setEnabled(HB.getBDF(), true);
+      ++NumSafe;
+    }
+    if (NumSafe == 0)
+      std::cout << "No chipset feature of " << HB.getName()
+                << " is known to be safe, nothing to enable" << '\n';
+  } else {
+    const ChipsetFeature *Feature = HB.findChipsetFeature(Args.ChipsetOptName);
+    if (Feature == nullptr) {
+      std::cerr << "Unknown chipset feature '" << Args.ChipsetOptName << "'"
+                << '\n';
+      return false;
+    }
+    if (!Feature->Safe) {
+      std::cerr << "The bits of '" << Feature->Name << "' have not been "
+                << "verified for " << HB.getName() << ", not changing them"
+                << '\n';
+      return false;
+    }
+    Success = Feature->setEnabled(HB.getBDF(), Cmd == "enable");
+  }
+  Show();
+  return Success;
+}
+
+bool SiSFSB::pciTune() {
+  if (Args.PCITune == "restore")
+    return PCITuner::restore();
+  std::vector<PCIRegChange> Changes = PCITuner::plan();
+  for (const PCIRegChange &C : Changes) {
+    C.print(std::cout);
+    std::cout << '\n';
+  }
+  {
+    DecimalGuard DG(std::cout);
+    std::cout << Changes.size() << " change(s)" << '\n';
+  }
+  if (Args.PCITune == "dry-run" || Changes.empty())
+    return true;
+  if (!PCITuner::apply(Changes))
+    return false;
+  std::cout << "Applied, use -pci-tune restore to undo" << '\n';
+  return true;
+}
+
+bool SiSFSB::mtrr() {
+  std::unique_ptr<MSRBackend> MSR;
+  if (Args.MSRFile.empty()) {
+#ifdef LINUX
+    std::cerr << "On Linux -mtrr only works on a simulated MSR file given "
+                 "with -msr-file <File>, use /proc/mtrr for the real MTRRs"
+              << '\n';
+    return false;
+#else
+    MSR = std::make_unique<NativeMSRBackend>();
+#endif
+  } else {
+    auto FileMSR = std::make_unique<FileMSRBackend>(Args.MSRFile);
+    if (!FileMSR->isOpen())
+      return false;
+    MSR = std::move(FileMSR);
+  }
+  std::cout << "MSR access: " << MSR->getName() << '\n';
+  MTRR Mtrr(*MSR);
+  // A simulated MSR file may describe a different CPU than the host's.
+  if (Args.MSRFile.empty() && !Mtrr.supportsWC()) {
+    std::cerr << "CPU does not support write-combining MTRRs" << '\n';
+    return false;
+  }
+  auto ListRanges = [&Mtrr]() -> bool {
+    auto Ranges = Mtrr.getRanges();
+    if (!Ranges) {
+      std::cerr << "Failed to read the MTRRs" << '\n';
+      return false;
+    }
+    for (const MTRR::Range &R : *Ranges) {
+      R.print(std::cout);
+      std::cout << '\n';
+    }
+    return true;
+  };
+  if (Args.MTRR == "list")
+    return ListRanges();
+  if (Args.MTRR == "remove") {
+    if (!Mtrr.removeRange(Args.MTRRIdx))
+      return false;
+    return ListRanges();
+  }
+  auto FB = findVGAFrameBuffer();
+  if (!FB) {
+    std::cerr << "No VGA frame buffer found" << '\n';
+    return false;
+  }
+  {
+    DecimalGuard DG(std::cout);
+    std::cout << "VGA frame buffer: " << FB->Addr << " BAR 0x" << std::hex
+              << (int)FB->Reg << " base 0x" << FB->Base << " size " << std::dec
+              << FB->Size / 1024 << "KB" << '\n';
+  }
+  if (!Mtrr.addRange(FB->Base, FB->Size, MTRR::WriteCombiningType))
+    return false;
+  return ListRanges();
+}
+
+bool SiSFSB::settle(const FreqEntry &Current) {
+  std::optional<SettleMeter> Meter = SettleMeter::getTSCMeter();
+  if (!Meter)
+    return false;
+  std::optional<SettleTable> Table = SettleTable::load(SettleTable::DefaultFile);
+  if (!Table)
+    return false;
+  PLL &Pll = S.getPLL();
+  SMBus &SMB = S.getSMB();
+  // Each step of the ramp up to the target and back down.
+  std::vector<FreqEntry> Path = Pll.getRampPath(Current, Args.Fsb);
+  Path.push_back(Args.Fsb);
+  std::vector<FreqEntry> Back = Pll.getRampPath(Args.Fsb, Current);
+  Path.insert(Path.end(), Back.begin(), Back.end());
+  Path.push_back(Current);
+  FreqEntry From = Current;
+  for (const FreqEntry &To : Path) {
+    // Flush, in case the machine hangs at this step.
+    std::cout << "Switching to " << To << std::endl;
+    std::optional<SettleEntry> E = Meter->measure(Pll, SMB, From, To);
+    if (!E) {
+      std::cerr << "Going back to " << Current << '\n';
+      Pll.setFSB(Current, SMB);
+      return false;
+    }
+    std::cout << "  ";
+    E->print(std::cout);
+    std::cout << '\n';
+    Table->add(*E);
+    From = To;
+  }
+  if (!Table->save(SettleTable::DefaultFile))
+    return false;
+  DecimalGuard DG(std::cout);
+  std::cout << "Saved " << Table->size() << " transition(s) to "
+            << SettleTable::DefaultFile << '\n';
+  return true;
+}
+
+bool SiSFSB::snapshot() {
+  if (Args.Snapshot == "diff") {
+    std::optional<Snapshot> From = Snapshot::load(Args.SnapshotFile);
+    std::optional<Snapshot> To = Snapshot::load(Args.SnapshotFile2);
+    if (!From || !To)
+      return false;
+    if (Snapshot::printDiff(*From, *To, std::cout) == 0)
+      std::cout << "No differences" << '\n';
+    return true;
+  }
+  // Without -pll the snapshot has no PLL block, unless we restore one that
+  // names its PLL.
+  std::string PLLName = Args.PLL;
+  std::optional<Snapshot> Saved;
+  if (Args.Snapshot == "restore") {
+    Saved = Snapshot::load(Args.SnapshotFile);
+    if (!Saved)
+      return false;
+    Saved->print(std::cout);
+    std::cout << '\n';
+    if (PLLName.empty())
+      PLLName = Saved->PLL;
+  }
+  if (!PLLName.empty()) {
+    if (toLower(PLLName) != PLL::AutoStr &&
+        !S.getChips().supportPLL(PLLName)) {
+      std::cerr << "Unsupported PLL: '" << PLLName << "'" << '\n';
+      return false;
+    }
+    if (!S.attachPLL(PLLName))
+      return false;
+  }
+  if (Saved)
+    return Saved->restore(S);
+  std::optional<Snapshot> Snap = Snapshot::capture(S);
+  if (!Snap || !Snap->save(Args.SnapshotFile))
+    return false;
+  Snap->print(std::cout);
+  std::cout << '\n' << "Saved to " << Args.SnapshotFile << '\n';
+  return true;
+}
 
 bool SiSFSB::run() {
+  if (Args.ShowTiming)
+    Timing::enable();
+  PhaseTimer Phase("pll-lookup");
+  Chips &AllChips = S.getChips();
   const std::string PLLName = Args.PLL;
-  if (PLLName.empty() || !AllChips.supportPLL(PLLName)) {
+  bool AutoPLL = toLower(PLLName) == PLL::AutoStr;
+  if (Args.needsPLL() && !AutoPLL &&
+      (PLLName.empty() || !AllChips.supportPLL(PLLName))) {
     if (!PLLName.empty())
-      std::cerr << "Unsupported PLL: '" << PLLName << "'" << std::endl;
-    std::cerr << "Please specify a supported PLL: -pll <PLL>" << std::endl;
+      std::cerr << "Unsupported PLL: '" << PLLName << "'" << '\n';
+    std::cerr << "Please specify a supported PLL: -pll <PLL|" << PLL::AutoStr
+              << ">" << '\n';
     AllChips.listSupportedPLLs(std::cerr);
     return false;
   }
-  PLL *Pll = AllChips.findPLL(Args.PLL);
-  if (Pll == nullptr)
-    exit(1);
-
+  // Catch bad governor configurations and scripts before touching the
+  // hardware.
+  std::optional<GovernorConfig> GovCfg;
+  if (!Args.Governor.empty()) {
+    GovCfg = GovernorConfig::parse(Args.Governor);
+    if (!GovCfg)
+      return false;
+  }
+  std::optional<Script> Scr;
+  if (!Args.Script.empty()) {
+    Scr = Script::load(Args.Script);
+    if (!Scr)
+      return false;
+    if (Scr->needsPLL() && PLLName.empty()) {
+      std::cerr << "The script has pll commands, please specify -pll <PLL|"
+                << PLL::AutoStr << ">" << '\n';
+      return false;
+    }
+  }
   const std::string &FreqStr = Args.Fsb.getFreqStr();
-  if (toLower(FreqStr) == FreqEntry::ListStr) {
-    Pll->dumpFreqTable(std::cout);
+  bool ListFreqs = toLower(FreqStr) == FreqEntry::ListStr;
+
+  if (Args.needsPLL() && !AutoPLL && ListFreqs) {
+    AllChips.findPLL(Args.PLL)->dumpFreqTable(std::cout);
     return true;
   }
 
   std::cout << std::hex;
   std::cerr << std::hex;
 
-  // Find a supported host bridge based on VendorID/DeviceID.
-  HostToPCIBridge *HostBridge = AllChips.findHostBridge();
-  if (HostBridge == nullptr)
-    exit(1);
+  // Without -fsb this only stresses the CPU at its current clock.
+  if (Args.StressCPUSeconds && Args.Fsb.bad()) {
+    Phase.next("stress-cpu");
+    return CPUStress::run(*Args.StressCPUSeconds);
+  }
+  // These work on any PCI machine, no need for a supported host bridge.
+  if (Args.ListPCI) {
+    Phase.next("lspci");
+    PCI::listDevices();
+    return true;
+  }
+  if (!Args.PCITune.empty()) {
+    Phase.next("pci-tune");
+    return pciTune();
+  }
+  if (!Args.MTRR.empty()) {
+    Phase.next("mtrr");
+    return mtrr();
+  }
+  // Only reads the files.
+  if (Args.Snapshot == "diff") {
+    Phase.next("snapshot");
+    return snapshot();
+  }
+  // Runs against a SimSMBus, no hardware needed.
+  if (Args.IOBudget) {
+    Phase.next("io-budget");
+    return IOBudgetCheck::run();
+  }
+  if (Args.MNPLLCheck) {
+    Phase.next("mnpll-check");
+    return MNPLLCheck::run();
+  }
+  if (Scr && !Scr->needsSMBus()) {
+    Phase.next("script");
+    return Scr->run(S, PLLName, !Args.IgnoreSPD);
+  }
 
-  // Initialize the I2C (SMB) bus, which is where the PLL lives.
-  if (!HostBridge->initSMB()) {
-    std::cerr << "Failed to initialize SMB" << std::endl;
-    exit(1);
+  Phase.stop();
+  if (Args.SimPLL) {
+    if (!Args.needsPLL() && !Scr) {
+      std::cerr << "-sim-pll only works with -fsb, -governor and -script"
+                << '\n';
+      return false;
+    }
+    // No hardware discovery, just a PLL with zeroed registers on its own bus.
+    auto Sim = std::make_unique<SimSMBus>();
+    Sim->addDevice(PLL::SlaveAddr, std::vector<uint8_t>(SimSMBus::PLLRegs, 0));
+    S.simulate(std::move(Sim));
+    std::cout << S.getSMB() << '\n';
+  } else {
+    if (!S.findHostBridge())
+      exit(1);
+    HostToPCIBridge &HostBridge = S.getHostBridge();
+    // This only touches the host bridge, so we don't need the SMBus.
+    if (!Args.ChipsetOpt.empty()) {
+      Phase.next("chipset-opt");
+      return chipsetOpt(HostBridge);
+    }
+
+    if (!S.initSMB())
+      exit(1);
+    SMBus &SMB = S.getSMB();
+
+    if (Args.ScanSMBus) {
+      Phase.next("scan-smbus");
+      scanSMBus(SMB);
+      return true;
+    }
+    if (Args.ShowSPD) {
+      Phase.next("spd");
+      showSPD(SMB);
+      return true;
+    }
+    if (Args.ShowDRAM) {
+      Phase.next("dram");
+      return showDRAM(HostBridge);
+    }
+
+    if (Args.MonitorIntervalMillis) {
+      Phase.next("monitor");
+      std::unique_ptr<HWMonitor> Mon = HWMonitor::find(SMB);
+      if (!Mon) {
+        std::cerr << "No supported hardware monitor found" << '\n';
+        exit(1);
+      }
+      std::cout << "Found " << Mon->getName() << " at 0x" << (int)Mon->getAddr()
+                << '\n';
+      HWMonSampler Sampler(*Mon);
+      return Sampler.run(*Args.MonitorIntervalMillis);
+    }
+  }
+  SMBus &SMB = S.getSMB();
+  if (Scr) {
+    Phase.next("script");
+    return Scr->run(S, PLLName, !Args.IgnoreSPD);
+  }
+  if (!Args.Snapshot.empty()) {
+    Phase.next("snapshot");
+    return snapshot();
   }
-  std::cout << "SMB initialized successfully" << std::endl;
-  auto &SMB = HostBridge->getSMB();
-  std::cout << SMB << std::endl;
 
-  // Do a quick write check to the PLL.
-  if (!Pll->check(*HostBridge))
+  if (!S.attachPLL(PLLName))
     exit(1);
-  std::cout << "PLL Chip passed quick write check: " << *Pll << std::endl;
+  PLL &Pll = S.getPLL();
+  if (std::optional<SettleTable> T =
+          SettleTable::load(SettleTable::DefaultFile))
+    S.setSettleTable(std::move(*T));
+  if (AutoPLL && ListFreqs) {
+    Pll.dumpFreqTable(std::cout);
+    return true;
+  }
 
-  // Query PLL for FSB via the I2C Bus (SMBus).
-  std::optional<FreqEntry> FEOpt = Pll->getFSB(SMB);
+  Phase.next("get-fsb");
+  std::optional<FreqEntry> FEOpt = S.getFrequency();
   if (!FEOpt)
     exit(1);
   std::cout << "Current FSB: " << *FEOpt << std::endl;
 
+  if (GovCfg) {
+    // Both frequencies will be used, so check the higher SDRAM clock.
+    Phase.next("spd-check");
+    if (!Args.IgnoreSPD &&
+        !SPD::checkSdramLimit(
+            SMB, std::max(GovCfg->Fast.getSdram(), GovCfg->Cool.getSdram())))
+      exit(1);
+    Phase.stop();
+    Governor G(S, *GovCfg);
+    return G.run();
+  }
+
   if (Args.Fsb.bad())
     exit(0);
 
-  // Try to set the new FSB.
-  std::cout << "Setting new FSB: " << Args.Fsb << std::endl;
-  if (!Pll->setFSB(Args.Fsb, SMB)) {
-    std::cerr << "Error setting FSB: " << *FEOpt << std::endl;
+  Phase.next("spd-check");
+  if (!Args.IgnoreSPD && !SPD::checkSdramLimit(SMB, Args.Fsb.getSdram()))
     exit(1);
+
+  if (Args.Settle) {
+    Phase.next("settle");
+    return settle(*FEOpt);
   }
+
+  // Try to set the new FSB. Flush, in case the machine hangs.
+  Phase.next("set-fsb");
+  FreqEntry PrevFE = *FEOpt;
+  std::cout << "Setting new FSB: " << Args.Fsb << std::endl;
+  if (!S.setFrequency(Args.Fsb, Args.RampDwellMillis))
+    exit(1);
   // Get the FSB once again to check if it was set.
-  FEOpt = Pll->getFSB(SMB);
+  Phase.next("verify");
+  FEOpt = S.getFrequency();
   if (!FEOpt)
     exit(1);
-  std::cout << "Current FSB: " << *FEOpt << std::endl;
+  std::cout << "Current FSB: " << *FEOpt << '\n';
+
+  if (Args.StressCPUSeconds) {
+    Phase.next("stress-cpu");
+    if (!CPUStress::run(*Args.StressCPUSeconds)) {
+      std::cerr << "Unstable at " << Args.Fsb << ", going back to " << PrevFE
+                << std::endl;
+      S.setFrequency(PrevFE, Args.RampDwellMillis);
+      exit(1);
+    }
+  }
   return true;
 }
@@ -7,18 +7,37 @@
 #define __SRC_SISFSB_H__
 
 #include "args.h"
-#include "chips.h"
-
-class PLL;
+#include "session.h"
 
+/// The command line tool, a client of Session.
 class SiSFSB {
   Arguments &Args;
-  Chips AllChips;
+  Session S;
 
-  PLL *findPLL() const;
+  /// Lists the devices responding on \p SMB.
+  void scanSMBus(SMBus &SMB);
+  /// Prints the SPD contents of all DIMMs.
+  void showSPD(SMBus &SMB);
+  /// Prints the DRAM timings of \p HB. \Returns false if none are known.
+  bool showDRAM(HostToPCIBridge &HB);
+  /// Runs the -chipset-opt command on \p HB. \Returns false on error.
+  bool chipsetOpt(HostToPCIBridge &HB);
+  /// Runs the -pci-tune command. \Returns false on error.
+  bool pciTune();
+  /// Runs the -mtrr command. \Returns false on error.
+  bool mtrr();
+  /// Measures the settle times from \p Current to the -fsb frequency and
+  /// back, and adds them to the settle table. \Returns false on error.
+  bool settle(const FreqEntry &Current);
+  /// Runs the -snapshot command. \Returns false on error.
+  bool snapshot();
 
 public:
-  SiSFSB(Arguments &Args) : Args(Args) {}
+  // A cached run skips the discovery, so it would not replay a log recorded
+  // without the cache (or the other way around).
+  SiSFSB(Arguments &Args)
+      : Args(Args), S(!Args.NoCache && Args.RecordFile.empty() &&
+                      Args.ReplayFile.empty()) {}
   /// \Returns true on success, false if an error occured.
   bool run();
 };
@@ -0,0 +1,76 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "sisfsb_api.h"
+#include "session.h"
+#include <algorithm>
+
+struct sisfsb_session {
+  Session S;
+  sisfsb_session(bool UseCache) : S(UseCache) {}
+};
+
+sisfsb_session *sisfsb_open(const char *pll, int use_cache) {
+  if (pll == nullptr) {
+    std::cerr << "sisfsb_open: no PLL given" << '\n';
+    return nullptr;
+  }
+  auto *Sess = new sisfsb_session(use_cache != 0);
+  if (!Sess->S.discover() || !Sess->S.attachPLL(pll)) {
+    delete Sess;
+    return nullptr;
+  }
+  return Sess;
+}
+
+void sisfsb_close(sisfsb_session *s) { delete s; }
+
+int sisfsb_get_frequency(sisfsb_session *s, sisfsb_freq *freq) {
+  std::optional<FreqEntry> FE = s->S.getFrequency();
+  if (!FE)
+    return -1;
+  *freq = {FE->getFsb(), FE->getSdram(), FE->getPci()};
+  return 0;
+}
+
+int sisfsb_set_frequency(sisfsb_session *s, const sisfsb_freq *freq,
+                         unsigned ramp_dwell_ms) {
+  std::optional<unsigned> Dwell;
+  if (ramp_dwell_ms != 0)
+    Dwell = ramp_dwell_ms;
+  FreqEntry FE(freq->fsb, freq->sdram, freq->pci);
+  return s->S.setFrequency(FE, Dwell) ? 0 : -1;
+}
+
+int sisfsb_list_frequencies(sisfsb_session *s, sisfsb_freq *freqs, int max) {
+  std::vector<FreqEntry> FEs = s->S.listFrequencies();
+  for (int Idx = 0, E = std::min<int>(FEs.size(), max); Idx < E; ++Idx)
+    freqs[Idx] = {FEs[Idx].getFsb(), FEs[Idx].getSdram(), FEs[Idx].getPci()};
+  return FEs.size();
+}
+
+int sisfsb_smbus_read_byte_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                uint8_t *val) {
+  std::optional<uint8_t> Val = s->S.getSMB().readByteData(addr, cmd);
+  if (!Val)
+    return -1;
+  *val = *Val;
+  return 0;
+}
+
+int sisfsb_smbus_write_byte_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                 uint8_t val) {
+  return s->S.getSMB().writeByteData(addr, cmd, val) ? 0 : -1;
+}
+
+int sisfsb_smbus_read_block_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                 uint8_t *buf, int max) {
+  std::vector<uint8_t> Block = s->S.getSMB().readBlockData(addr, cmd);
+  if (Block.empty())
+    return -1;
+  int Len = std::min<int>(Block.size(), max);
+  std::copy(Block.begin(), Block.begin() + Len, buf);
+  return Len;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2025 Scrap Computing
+ *
+ * C interface of libsisfsb. All functions that return int return 0 on
+ * success and -1 on error, with the error message printed to stderr.
+ */
+
+#ifndef __SRC_SISFSB_API_H__
+#define __SRC_SISFSB_API_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sisfsb_session sisfsb_session;
+
+typedef struct sisfsb_freq {
+  float fsb;
+  float sdram;
+  float pci;
+} sisfsb_freq;
+
+/* Discovers the host bridge, the SMBus and the PLL named `pll`, which must
+ * not be NULL. "auto" only finds PLLs with a known register signature. Uses
+ * the discovery cache if `use_cache` is non-zero. Returns NULL on error. */
+sisfsb_session *sisfsb_open(const char *pll, int use_cache);
+void sisfsb_close(sisfsb_session *s);
+
+int sisfsb_get_frequency(sisfsb_session *s, sisfsb_freq *freq);
+/* Ramps to `freq` if `ramp_dwell_ms` is non-zero. */
+int sisfsb_set_frequency(sisfsb_session *s, const sisfsb_freq *freq,
+                         unsigned ramp_dwell_ms);
+/* Fills in up to `max` entries of `freqs` and returns the number of
+ * frequencies the PLL supports, which may be more than `max`. */
+int sisfsb_list_frequencies(sisfsb_session *s, sisfsb_freq *freqs, int max);
+
+/* Raw SMBus access. */
+int sisfsb_smbus_read_byte_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                uint8_t *val);
+int sisfsb_smbus_write_byte_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                 uint8_t val);
+/* Returns the number of bytes read into `buf`, at most `max`. */
+int sisfsb_smbus_read_block_data(sisfsb_session *s, uint8_t addr, uint8_t cmd,
+                                 uint8_t *buf, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SRC_SISFSB_API_H__ */
@@ -5,153 +5,301 @@
 
 #include "smbus.h"
 #include <iostream>
+#include <iterator>
 
-bool SiSSMBus::transfer(TransferTy TrTy) {
-  if (Debug) {
-    DecimalGuard DG(std::cout);
-    std::cout << "SMBus " << __FUNCTION__
-              << "(TrTy=" << (int)getTransferTyMask(TrTy) << ")" << std::endl;
+const char *SiSSMBus::getName(Fault F) {
+  switch (F) {
+  case Fault::None:
+    return "ready";
+  case Fault::HostBusy:
+    return "host busy";
+  case Fault::SlaveBusy:
+    return "slave busy";
+  case Fault::Collision:
+    return "collision";
+  case Fault::DeviceError:
+    return "device error";
+  }
+  return "unknown";
+}
+
+const char *SiSSMBus::getName(Remedy R) {
+  switch (R) {
+  case Remedy::Wait:
+    return "wait";
+  case Remedy::ClearStatus:
+    return "clear-status";
+  case Remedy::Kill:
+    return "kill";
+  case Remedy::NumRemedies:
+    break;
   }
-  // Check if ready.
+  return "unknown";
+}
+
+SiSSMBus::Fault SiSSMBus::getFault() {
   uint8_t Control = getControl();
-  uint32_t Timeout = 10;
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__
-              << " Checking if HostBusyMask|SlaveBusyMask";
-  if (Control & (HostBusyMask | SlaveBusyMask)) {
-    // Try to kill the current transfer.
+  if (Control & HostBusyMask)
+    return Fault::HostBusy;
+  if (Control & SlaveBusyMask)
+    return Fault::SlaveBusy;
+  uint8_t Status = getStatus();
+  if (Status & CollisionMask)
+    return Fault::Collision;
+  if (Status & DevErrMask)
+    return Fault::DeviceError;
+  return Fault::None;
+}
+
+void SiSSMBus::waitIdle(unsigned Micros) {
+  uint64_t Start = getMicros();
+  while ((getControl() & (HostBusyMask | SlaveBusyMask)) &&
+         getMicros() - Start < Micros)
+    ;
+}
+
+void SiSSMBus::apply(Remedy R) {
+  switch (R) {
+  case Remedy::Wait:
+    waitIdle(IdleWaitMicros);
+    break;
+  case Remedy::ClearStatus:
+    break;
+  case Remedy::Kill:
     setHostControl(KillMask, TransferTy::Quick);
-    delay(100);
-    Control = getControl();
-    if (Debug)
-      std::cout << " .. ";
-  }
-  while (Control & (HostBusyMask | SlaveBusyMask)) {
-    Control = getControl();
-    delay(100);
-    if (--Timeout == 0) {
-      std::cerr << "Host or slave busy!" << std::endl;
-      return false;
-    }
-    if (Debug)
-      std::cout << ".";
+    waitIdle(RemedyWaitMicros);
+    break;
+  case Remedy::NumRemedies:
+    break;
   }
-  if (Debug)
-    std::cout << "Done!" << std::endl;
-
-  // TODO: Is this needed?
-  // Disable timeout interrupt
-  setControl(Control & ~HostMasterTimeoutMask);
-  // TODO: Is this needed?
-  setStatus(getStatus() & ClearSlaveAlertSlaveAliasHostSlaveMask);
+  // A finished or killed transaction leaves sticky status bits behind.
+  setStatus(ClearStickyBitsMask);
+}
 
-  auto WaitForTransfer = [this, TrTy]() {
-    if (Debug)
-      std::cout << "WaitForTransfer ";
-    uint32_t TimeoutCnt = 0;
-    uint8_t Status = 0;
-    do {
-      // Sleep 100ms otherwise SMBus will be busy
-      delay(100);
-      if (Debug)
-        std::cout << ".";
-      Status = getStatus();
-      if (TrTy == TransferTy::BlockData && (Status & BlockFinishedMask))
-        break;
-    } while ((Status & ErrMask) && (++TimeoutCnt < TransferTimeout));
-    if (TimeoutCnt >= TransferTimeout) {
-      std::cerr << "Transfer timeout" << std::endl;
-      return false;
-    }
-    if (Status & ErrMask) {
-      std::cerr << "Transfer failed (error)" << std::endl;
-      return false;
-    }
-    if (Debug)
-      std::cout << "Done" << std::endl;
+bool SiSSMBus::recover() {
+  Fault F = getFault();
+  if (F == Fault::None)
     return true;
-  };
-  if (!WaitForTransfer()) {
-    std::cerr << "Transfer timeout" << std::endl;
-    return false;
+  // A kill can't end a slave transaction, and clearing the status
+  // can't end a host transaction.
+  static const Remedy HostBusyRemedies[] = {Remedy::Wait, Remedy::Kill};
+  static const Remedy SlaveBusyRemedies[] = {Remedy::Wait};
+  static const Remedy ErrorRemedies[] = {Remedy::ClearStatus, Remedy::Kill};
+  const Remedy *Begin = ErrorRemedies;
+  const Remedy *End = std::end(ErrorRemedies);
+  if (F == Fault::HostBusy) {
+    Begin = HostBusyRemedies;
+    End = std::end(HostBusyRemedies);
+  } else if (F == Fault::SlaveBusy) {
+    Begin = SlaveBusyRemedies;
+    End = std::end(SlaveBusyRemedies);
+  }
+  for (const Remedy *R = Begin; R != End; ++R) {
+    apply(*R);
+    if (getFault() == Fault::None) {
+      ++Recoveries[(unsigned)*R];
+      if (isDebug())
+        std::cout << "SMBus " << getName(F) << ", recovered with "
+                  << getName(*R) << '\n';
+      return true;
+    }
   }
+  ++FailedRecoveries;
+  std::cerr << "SMBus " << getName(F) << ", could not recover!" << '\n';
+  return false;
+}
+
+bool SiSSMBus::transfer(TransferTy TrTy) {
+  ++Transactions;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__
+              << "(TrTy=" << Dec(getTransferTyMask(TrTy)) << ")\n";
+  // Check if ready, and get it ready if not.
+  if (!recover())
+    return false;
+
+  // We poll the status, so keep the host master timeout interrupt off.
+  // recover() already cleared any error, and the TrComplete/BlockFinished
+  // bits are not looked at here, so the status needs no clearing.
+  setControl(getControl() & ~HostMasterTimeoutMask);
 
   // Start transfer by setting bit 4.
   setHostControl(StartTransferMask, TrTy);
 
-  if (!WaitForTransfer()) {
-    std::cerr << "Transfer timeout" << std::endl;
+  // Sleep 100ms otherwise SMBus will be busy
+  delay(100);
+  // The error bits are sticky, so there is no point in waiting any longer.
+  uint8_t Status = getStatus();
+  if (Status & ErrMask) {
+    std::cerr << "Transfer failed (error)" << '\n';
+    setStatus(ClearStickyBitsMask);
     return false;
   }
 
   // End transaction, clear sticky bits
   setStatus(ClearStickyBitsMask);
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << " Finished!" << std::endl;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << " Finished!" << '\n';
   return true;
 }
 
+std::vector<uint8_t> SMBus::scan() {
+  std::vector<uint8_t> Found;
+  for (unsigned Addr = MinAddr; Addr <= MaxAddr; ++Addr) {
+    // Like i2cdetect, use quick reads for the EEPROM ranges since a quick
+    // write can be interpreted as a write-protect command by some of them.
+    bool Read = (Addr >= 0x30 && Addr <= 0x37) || (Addr >= 0x50 && Addr <= 0x5f);
+    if (probe(Addr, Read))
+      Found.push_back(Addr);
+  }
+  return Found;
+}
+
+const char *SMBus::getDeviceClass(uint8_t Addr) {
+  if (Addr >= 0x50 && Addr <= 0x57)
+    return "SPD EEPROM";
+  if (Addr >= 0x30 && Addr <= 0x37)
+    return "SPD write protect";
+  if (Addr == 0x68 || Addr == 0x69 || Addr == 0x6a)
+    return "Clock generator";
+  if ((Addr >= 0x28 && Addr <= 0x2f) || (Addr >= 0x48 && Addr <= 0x4f))
+    return "Hardware monitor";
+  return "Unknown";
+}
+
+void SMBus::step(SMBusRequest &Req) {
+  using Op = SMBusRequest::Op;
+  bool Ok = false;
+  auto SetByte = [&Req, &Ok](std::optional<uint8_t> Byte) {
+    if ((Ok = Byte.has_value()))
+      Req.Data = {*Byte};
+  };
+  switch (Req.Ty) {
+  case Op::ReadQuick:
+    Ok = readQuick(Req.Addr);
+    break;
+  case Op::WriteQuick:
+    Ok = writeQuick(Req.Addr);
+    break;
+  case Op::ReadByte:
+    SetByte(readByte(Req.Addr));
+    break;
+  case Op::WriteByte:
+    Ok = writeByte(Req.Addr, Req.Cmd);
+    break;
+  case Op::ReadByteData:
+    SetByte(readByteData(Req.Addr, Req.Cmd));
+    break;
+  case Op::WriteByteData:
+    Ok = !Req.Data.empty() && writeByteData(Req.Addr, Req.Cmd, Req.Data[0]);
+    break;
+  case Op::ReadWordData:
+    if (auto Word = readWordData(Req.Addr, Req.Cmd)) {
+      Req.Data = {(uint8_t)*Word, (uint8_t)(*Word >> 8)};
+      Ok = true;
+    }
+    break;
+  case Op::ReadBlockData:
+    Req.Data = readBlockData(Req.Addr, Req.Cmd);
+    Ok = !Req.Data.empty();
+    break;
+  case Op::WriteBlockData:
+    Ok = writeBlockData(Req.Addr, Req.Cmd, Req.Data);
+    break;
+  }
+  Req.St = Ok ? SMBusRequest::State::Done : SMBusRequest::State::Failed;
+}
+
+bool SiSSMBus::probe(uint8_t Addr, bool Read) {
+  if (getControl() & (HostBusyMask | SlaveBusyMask)) {
+    // Let the slow path deal with a busy bus.
+    setAddr(Addr, Read ? RW::Read : RW::Write);
+    return transfer(TransferTy::Quick);
+  }
+  ++Transactions;
+  setStatus(ClearStickyBitsMask);
+  setAddr(Addr, Read ? RW::Read : RW::Write);
+  setHostControl(StartTransferMask, TransferTy::Quick);
+  uint8_t Status = 0;
+  for (uint32_t Cnt = 0; Cnt != ProbePollLimit; ++Cnt) {
+    Status = getStatus();
+    if (Status & (TrCompleteMask | ErrMask))
+      break;
+  }
+  setStatus(ClearStickyBitsMask);
+  return (Status & TrCompleteMask) && !(Status & ErrMask);
+}
+
 bool SiSSMBus::readQuick(uint8_t Addr) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr << ")"
-              << std::endl;
-  setAddr(SlaveAddr, RW::Read);
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr) << ")\n";
+  setAddr(Addr, RW::Read);
   return transfer(TransferTy::Quick);
 }
 
 bool SiSSMBus::writeQuick(uint8_t Addr) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr << ")"
-              << std::endl;
-  setAddr(SlaveAddr, RW::Write);
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr) << ")\n";
+  setAddr(Addr, RW::Write);
   return transfer(TransferTy::Quick);
 }
 
 std::optional<uint8_t> SiSSMBus::readByte(uint8_t Addr) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr << ")"
-              << std::endl;
-  setAddr(SlaveAddr, RW::Read);
-  return transfer(TransferTy::Byte);
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr) << ")\n";
+  setAddr(Addr, RW::Read);
+  if (!transfer(TransferTy::Byte))
+    return std::nullopt;
+  return getData(/*Offset=*/0);
 }
 
 bool SiSSMBus::writeByte(uint8_t Addr, uint8_t Cmd) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr
-              << ", Cmd=" << (int)Cmd << ")" << std::endl;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ")\n";
   setCmd(Cmd);
-  setAddr(SlaveAddr, RW::Write);
+  setAddr(Addr, RW::Write);
   return transfer(TransferTy::Byte);
 }
 
 std::optional<uint8_t> SiSSMBus::readByteData(uint8_t Addr, uint8_t Cmd) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr
-              << ", Cmd=" << (int)Cmd << ")" << std::endl;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ")\n";
   setCmd(Cmd);
-  setAddr(SlaveAddr, RW::Read);
+  setAddr(Addr, RW::Read);
   if (!transfer(TransferTy::ByteData))
     return std::nullopt;
   return getData(/*Offset=*/0);
 }
 
 bool SiSSMBus::writeByteData(uint8_t Addr, uint8_t Cmd, uint8_t Val) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr
-              << ", Cmd=" << (int)Cmd << ", Val=" << (int)Val << ")"
-              << std::endl;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ", Val=0x" << Hex(Val) << ")\n";
   setCmd(Cmd);
-  setLen(Val);
-  setAddr(SlaveAddr, RW::Write);
+  setData(Val, /*Offset=*/0);
+  setAddr(Addr, RW::Write);
   return transfer(TransferTy::ByteData);
 }
 
+std::optional<uint16_t> SiSSMBus::readWordData(uint8_t Addr, uint8_t Cmd) {
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ")\n";
+  setCmd(Cmd);
+  setAddr(Addr, RW::Read);
+  if (!transfer(TransferTy::WordData))
+    return std::nullopt;
+  return getData(/*Offset=*/0) | getData(/*Offset=*/1) << 8;
+}
+
 std::vector<uint8_t> SiSSMBus::readBlockData(uint8_t Addr, uint8_t Cmd) {
-  if (Debug)
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr
-              << ", Cmd=0x" << (int)Cmd << ")" << std::endl;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ")\n";
   setCmd(Cmd);
-  setAddr(SlaveAddr, RW::Read);
+  setAddr(Addr, RW::Read);
   if (!transfer(TransferTy::BlockData))
     return {};
   uint8_t Len = std::min(getLen(), (uint8_t)32);
@@ -168,21 +316,194 @@ std::vector<uint8_t> SiSSMBus::readBlockData(uint8_t Addr, uint8_t Cmd) {
 
 bool SiSSMBus::writeBlockData(uint8_t Addr, uint8_t Cmd,
                               const std::vector<uint8_t> Data) {
-  if (Debug) {
-    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << (int)Addr
-              << ", Cmd=" << (int)Cmd << ", Data=[";
+  if (isDebug()) {
+    std::cout << "SMBus " << __FUNCTION__ << "(Addr=0x" << Hex(Addr)
+              << ", Cmd=0x" << Hex(Cmd) << ", Data=[";
     for (auto D : Data)
-      std::cout << (int)D << ", ";
-    std::cout << "])" << std::endl;
+      std::cout << "0x" << Hex(D) << ", ";
+    std::cout << "])" << '\n';
+  }
+  if (Data.size() > MaxWriteBlockLen) {
+    std::cerr << "SMBus block write of " << Data.size() << " bytes exceeds "
+              << (int)MaxWriteBlockLen << '\n';
+    return false;
   }
   setCmd(Cmd);
+  // The controller sends SMB_COUNT bytes, which still holds the length of
+  // the last block read unless we set it.
+  setLen(Data.size());
   for (uint8_t Offset = 0, E = Data.size(); Offset != E; ++Offset)
     setData(Data[Offset], Offset);
-  setAddr(SlaveAddr, RW::Write);
+  setAddr(Addr, RW::Write);
   return transfer(TransferTy::BlockData);
 }
 
+void SiSSMBus::start(SMBusRequest &Req) {
+  using Op = SMBusRequest::Op;
+  ++Transactions;
+  if (isDebug())
+    std::cout << "SMBus " << __FUNCTION__ << "(Op=" << Dec((unsigned)Req.Ty)
+              << ", Addr=0x" << Hex(Req.Addr) << ", Cmd=0x" << Hex(Req.Cmd)
+              << ")\n";
+  setControl(getControl() & ~HostMasterTimeoutMask);
+  // Unlike transfer(), step() polls TrComplete and BlockFinished, so clear
+  // any left over from someone else, or they would end this one early.
+  setStatus(getStatus() & ClearSlaveAlertSlaveAliasHostSlaveMask);
+  TransferTy TrTy = TransferTy::Quick;
+  RW ReadOrWrite = RW::Read;
+  switch (Req.Ty) {
+  case Op::ReadQuick:
+    break;
+  case Op::WriteQuick:
+    ReadOrWrite = RW::Write;
+    break;
+  case Op::ReadByte:
+    TrTy = TransferTy::Byte;
+    break;
+  case Op::WriteByte:
+    TrTy = TransferTy::Byte;
+    ReadOrWrite = RW::Write;
+    setCmd(Req.Cmd);
+    break;
+  case Op::ReadByteData:
+    TrTy = TransferTy::ByteData;
+    setCmd(Req.Cmd);
+    break;
+  case Op::WriteByteData:
+    TrTy = TransferTy::ByteData;
+    ReadOrWrite = RW::Write;
+    setCmd(Req.Cmd);
+    setData(Req.Data.empty() ? 0 : Req.Data[0], /*Offset=*/0);
+    break;
+  case Op::ReadWordData:
+    TrTy = TransferTy::WordData;
+    setCmd(Req.Cmd);
+    break;
+  case Op::ReadBlockData:
+    TrTy = TransferTy::BlockData;
+    setCmd(Req.Cmd);
+    break;
+  case Op::WriteBlockData:
+    TrTy = TransferTy::BlockData;
+    ReadOrWrite = RW::Write;
+    setCmd(Req.Cmd);
+    // See writeBlockData().
+    setLen(Req.Data.size());
+    for (uint8_t Offset = 0, E = Req.Data.size(); Offset != E; ++Offset)
+      setData(Req.Data[Offset], Offset);
+    break;
+  }
+  setAddr(Req.Addr, ReadOrWrite);
+  setHostControl(StartTransferMask, TrTy);
+  Req.St = SMBusRequest::State::Running;
+  Req.StateMillis = getMillis();
+}
+
+void SiSSMBus::finish(SMBusRequest &Req) {
+  using Op = SMBusRequest::Op;
+  Req.St = SMBusRequest::State::Done;
+  switch (Req.Ty) {
+  case Op::ReadByte:
+  case Op::ReadByteData:
+    Req.Data = {getData(/*Offset=*/0)};
+    break;
+  case Op::ReadWordData:
+    Req.Data = {getData(/*Offset=*/0), getData(/*Offset=*/1)};
+    break;
+  case Op::ReadBlockData:
+    Req.Data.clear();
+    Req.Len = std::min(getLen(), (uint8_t)32);
+    if (Req.Len != 0)
+      Req.St = SMBusRequest::State::Draining;
+    break;
+  default:
+    break;
+  }
+}
+
+void SiSSMBus::step(SMBusRequest &Req) {
+  using State = SMBusRequest::State;
+  unsigned long Now = getMillis();
+  switch (Req.St) {
+  case State::Queued:
+    if (Req.Ty == SMBusRequest::Op::WriteBlockData &&
+        Req.Data.size() > MaxWriteBlockLen) {
+      std::cerr << "SMBus block write of " << Req.Data.size()
+                << " bytes exceeds " << (int)MaxWriteBlockLen << '\n';
+      Req.St = State::Failed;
+      return;
+    }
+    // Blocks for a few ms at most, and only if the controller is stuck.
+    if (!recover()) {
+      Req.St = State::Failed;
+      return;
+    }
+    start(Req);
+    return;
+  case State::Running: {
+    uint8_t Status = getStatus();
+    bool BlockDone = Req.Ty == SMBusRequest::Op::ReadBlockData &&
+                     (Status & BlockFinishedMask);
+    if (Status & ErrMask) {
+      std::cerr << "Transfer failed (error)" << '\n';
+      setStatus(ClearStickyBitsMask);
+      Req.St = State::Failed;
+      return;
+    }
+    if (!(Status & TrCompleteMask) && !BlockDone) {
+      if (Now - Req.StateMillis >= TransferTimeoutMillis) {
+        std::cerr << "Transfer timeout" << '\n';
+        setHostControl(KillMask, TransferTy::Quick);
+        Req.St = State::Failed;
+      }
+      return;
+    }
+    // End transaction, clear sticky bits. Not BlockFinished, that would
+    // acknowledge the first FIFO load of a block read before we read it.
+    setStatus(TrCompleteMask | ErrMask);
+    finish(Req);
+    return;
+  }
+  case State::Draining: {
+    // One 8 byte FIFO load per step, acknowledging each full one. The first
+    // one is there already, the next ones once BlockFinished is set again.
+    uint8_t Cnt = Req.Data.size();
+    if (Cnt != 0) {
+      uint8_t Status = getStatus();
+      if (Status & ErrMask) {
+        std::cerr << "Transfer failed (error)" << '\n';
+        setStatus(ClearStickyBitsMask);
+        Req.St = State::Failed;
+        return;
+      }
+      if (!(Status & BlockFinishedMask)) {
+        if (Now - Req.StateMillis >= TransferTimeoutMillis) {
+          std::cerr << "Transfer timeout" << '\n';
+          setHostControl(KillMask, TransferTy::Quick);
+          Req.St = State::Failed;
+        }
+        return;
+      }
+    }
+    do {
+      uint8_t Offset = Cnt % 8;
+      Req.Data.push_back(getData(Offset));
+      if (Offset == 7)
+        setStatus(BlockFinishedMask);
+    } while (++Cnt != Req.Len && Cnt % 8 != 0);
+    Req.StateMillis = Now;
+    if (Cnt == Req.Len) {
+      setStatus(ClearStickyBitsMask);
+      Req.St = State::Done;
+    }
+    return;
+  }
+  case State::Done:
+  case State::Failed:
+    return;
+  }
+}
+
 void SiSSMBus::print(std::ostream &OS) const {
-  OS << Name << " BaseAddr: 0x" << (int)BaseAddr << " SlaveAddr: 0x"
-     << (int)SlaveAddr << std::endl;
+  OS << Name << " BaseAddr: 0x" << (int)BaseAddr << '\n';
 }
@@ -6,6 +6,7 @@
 #ifndef __SRC_SMBUS_H__
 #define __SRC_SMBUS_H__
 
+#include "portio.h"
 #include "utils.h"
 #include <cstdint>
 #include <iostream>
@@ -13,27 +14,86 @@
 #include <string>
 #include <vector>
 
+/// A transaction for the non-blocking interface, see SMBusQueue.
+struct SMBusRequest {
+  enum class Op : uint8_t {
+    ReadQuick,
+    WriteQuick,
+    ReadByte,
+    WriteByte,
+    ReadByteData,
+    WriteByteData,
+    ReadWordData,
+    ReadBlockData,
+    WriteBlockData,
+  };
+  enum class State : uint8_t {
+    Queued,
+    /// Started, waiting for the controller to finish.
+    Running,
+    /// Reading the block data out of the controller.
+    Draining,
+    Done,
+    Failed,
+  };
+  Op Ty;
+  uint8_t Addr;
+  /// The command byte, or the byte for WriteByte.
+  uint8_t Cmd = 0;
+  /// The bytes to write or, once Done, the bytes read.
+  std::vector<uint8_t> Data;
+  State St = State::Queued;
+  /// When the current state started, for the timeouts.
+  unsigned long StateMillis = 0;
+  /// The block read length.
+  uint8_t Len = 0;
+
+  bool isFinished() const { return St == State::Done || St == State::Failed; }
+  bool ok() const { return St == State::Done; }
+};
+
 class SMBus {
 protected:
   std::string Name;
   /// The base address of SMBus.
   const uint16_t BaseAddr;
-  /// The address of the SMB component we want to talk to.
-  uint16_t SlaveAddr;
 
-  SMBus(std::string Name, uint16_t BaseAddr, uint16_t SlaveAddr)
-      : Name(Name), BaseAddr(BaseAddr), SlaveAddr(SlaveAddr) {}
+  SMBus(std::string Name, uint16_t BaseAddr) : Name(Name), BaseAddr(BaseAddr) {}
 
 public:
+  /// The range of 7-bit addresses that are not reserved.
+  static constexpr const uint8_t MinAddr = 0x03;
+  static constexpr const uint8_t MaxAddr = 0x77;
+  /// The number of transactions started so far, for -timing.
+  static inline unsigned long Transactions = 0;
+
+  virtual ~SMBus() = default;
+  uint16_t getBaseAddr() const { return BaseAddr; }
+  /// Checks if a device responds at \p Addr with a quick command, without
+  /// the delays of the regular transfers. \p Read selects a quick read, which
+  /// is the safe choice for EEPROMs.
+  virtual bool probe(uint8_t Addr, bool Read) = 0;
+  /// Probes all addresses and \Returns the ones that responded.
+  std::vector<uint8_t> scan();
+  /// \Returns the kind of device usually found at \p Addr.
+  static const char *getDeviceClass(uint8_t Addr);
+
   virtual bool readQuick(uint8_t Addr) = 0;
   virtual bool writeQuick(uint8_t Addr) = 0;
   virtual std::optional<uint8_t> readByte(uint8_t Addr) = 0;
   virtual bool writeByte(uint8_t Addr, uint8_t Cmd) = 0;
   virtual std::optional<uint8_t> readByteData(uint8_t Addr, uint8_t Cmd) = 0;
   virtual bool writeByteData(uint8_t Addr, uint8_t Cmd, uint8_t Val) = 0;
+  /// Reads the two bytes at \p Cmd and \p Cmd + 1, the first one in the low
+  /// byte. This is the largest read that works with EEPROMs, as they don't
+  /// implement the SMBus block protocol.
+  virtual std::optional<uint16_t> readWordData(uint8_t Addr, uint8_t Cmd) = 0;
   virtual std::vector<uint8_t> readBlockData(uint8_t Addr, uint8_t Cmd) = 0;
   virtual bool writeBlockData(uint8_t Addr, uint8_t Cmd,
                               const std::vector<uint8_t> Data) = 0;
+  /// Advances \p Req by at most one state, without waiting. The default does
+  /// the whole transaction with the blocking functions above.
+  virtual void step(SMBusRequest &Req);
   virtual void print(std::ostream &OS) const = 0;
   friend std::ostream &operator<<(std::ostream &OS, const SMBus &SMB) {
     SMB.print(OS);
@@ -88,13 +148,70 @@ class SiSSMBus final : public SMBus {
   static constexpr const uint8_t ClearSlaveAlertSlaveAliasHostSlaveMask = 0x1e;
 
   static constexpr const uint32_t TransferTimeout = 40;
+  /// The longest a transaction can keep the controller busy: a 32 byte block
+  /// read at 100KHz. recover() waits this long before killing it.
+  static constexpr const unsigned IdleWaitMicros = 3500;
+  /// How long recover() gives the controller after a kill.
+  static constexpr const unsigned RemedyWaitMicros = 200;
+  /// The longest step() waits for a transaction to complete.
+  static constexpr const unsigned long TransferTimeoutMillis =
+      TransferTimeout * 100;
+  /// The number of status polls before probe() gives up. Each poll is an I/O
+  /// read of roughly 1us, which is plenty for a quick command at 100KHz.
+  static constexpr const uint32_t ProbePollLimit = 10000;
+  /// The host data registers SMB_BYTE0_7 limit block writes to 8 bytes.
+  static constexpr const uint8_t MaxWriteBlockLen = 8;
 
   // Bit masks
   static constexpr const uint8_t ReadMask = 0x01;
   static constexpr const uint8_t WriteMask = 0x00;
 
 
+public:
+  /// What is wrong with the controller, from SMB_CNT and SMB_STS.
+  enum class Fault : uint8_t {
+    None,
+    /// A transaction is running, or the controller hangs in one.
+    HostBusy,
+    /// Another master is talking to our slave interface.
+    SlaveBusy,
+    /// We lost the arbitration to another master.
+    Collision,
+    /// The last transaction was not acknowledged or was killed.
+    DeviceError,
+  };
+  /// The ways recover() gets the controller ready, cheapest first.
+  enum class Remedy : uint8_t {
+    /// Wait for the running transaction to end.
+    Wait,
+    /// Clear the sticky status bits.
+    ClearStatus,
+    /// Kill the running transaction.
+    Kill,
+    NumRemedies,
+  };
+  /// How often each remedy fixed a fault, and how often none did. Printed by
+  /// -timing.
+  static inline unsigned long Recoveries[(unsigned)Remedy::NumRemedies] = {};
+  static inline unsigned long FailedRecoveries = 0;
+  static const char *getName(Fault F);
+  static const char *getName(Remedy R);
+
+private:
+  Fault getFault();
+  /// Polls for up to \p Micros until the controller is neither host nor
+  /// slave busy.
+  void waitIdle(unsigned Micros);
+  void apply(Remedy R);
+  /// Gets the controller ready for a transaction with the cheapest remedies
+  /// that work for its fault. Costs two reads if it is ready already and a
+  /// few ms at most if not. \Returns false if it is still not ready.
+  bool recover();
   bool transfer(TransferTy TrTy);
+  /// Sets up the registers for \p Req and starts it. Used by step().
+  void start(SMBusRequest &Req);
+  /// Reads the result of \p Req out of the controller once it completed.
+  void finish(SMBusRequest &Req);
 
   enum class RW {
     Read,
@@ -102,50 +219,54 @@ class SiSSMBus final : public SMBus {
   };
   void setAddr(uint8_t Addr, RW ReadOrWrite) {
     uint8_t RWMask = ReadOrWrite == RW::Read ? ReadMask : WriteMask;
-    if (Debug)
-      std::cout << "SMBus " << __FUNCTION__ << "(addr=0x" << BaseAddr << "+0x"
-                << (int)SMB_ADDR << ", val=0x" << (int)Addr << ")" << std::endl;
-    outportb(BaseAddr + SMB_ADDR, ((Addr & 0x7f) << 1) | RWMask);
+    if (isDebug())
+      std::cout << "SMBus " << __FUNCTION__ << "(addr=0x" << Hex(BaseAddr)
+                << "+0x" << Hex(SMB_ADDR) << ", val=0x" << Hex(Addr) << ")\n";
+    PortIO::outb(BaseAddr + SMB_ADDR, ((Addr & 0x7f) << 1) | RWMask);
   }
-  void setCmd(uint8_t Cmd) { outportb(BaseAddr + SMB_CMD, Cmd); }
+  void setCmd(uint8_t Cmd) { PortIO::outb(BaseAddr + SMB_CMD, Cmd); }
 
-  void setLen(uint8_t Len) { outportb(BaseAddr + SMB_COUNT, Len); }
+  void setLen(uint8_t Len) { PortIO::outb(BaseAddr + SMB_COUNT, Len); }
 
-  uint8_t getLen() { return inportb(BaseAddr + SMB_COUNT); }
+  uint8_t getLen() { return PortIO::inb(BaseAddr + SMB_COUNT); }
 
   uint8_t getData(uint8_t Offset) {
-    return inportb(BaseAddr + SMB_BYTE0_7 + Offset);
+    return PortIO::inb(BaseAddr + SMB_BYTE0_7 + Offset);
   }
   void setData(uint8_t Byte, uint8_t Offset) {
-    outportb(BaseAddr + SMB_BYTE0_7 + Offset, Byte);
+    PortIO::outb(BaseAddr + SMB_BYTE0_7 + Offset, Byte);
   }
 
-  uint8_t getControl() { return inportb(BaseAddr + SMB_CNT); }
+  uint8_t getControl() { return PortIO::inb(BaseAddr + SMB_CNT); }
 
-  void setControl(uint8_t Val) { outportb(BaseAddr + SMB_CNT, Val); }
+  void setControl(uint8_t Val) { PortIO::outb(BaseAddr + SMB_CNT, Val); }
 
   void setHostControl(uint8_t Val, TransferTy Ty) {
     uint8_t TyMask = getTransferTyMask(Ty);
-    outportb(BaseAddr + SMB_HOST_CNT, Val | TyMask);
+    PortIO::outb(BaseAddr + SMB_HOST_CNT, Val | TyMask);
   }
 
-  uint8_t getStatus() { return inportb(BaseAddr + SMB_STS); }
+  uint8_t getStatus() { return PortIO::inb(BaseAddr + SMB_STS); }
 
-  void setStatus(uint8_t Val) { outportb(BaseAddr + SMB_STS, Val); }
+  void setStatus(uint8_t Val) { PortIO::outb(BaseAddr + SMB_STS, Val); }
 
 public:
-  SiSSMBus(uint16_t BaseAddr, uint16_t SlaveAddr)
-      : SMBus("SiSSMBus", BaseAddr, SlaveAddr) {}
+  SiSSMBus(uint16_t BaseAddr) : SMBus("SiSSMBus", BaseAddr) {}
 
+  bool probe(uint8_t Addr, bool Read) override;
   bool readQuick(uint8_t Addr) override;
   bool writeQuick(uint8_t Addr) override;
   std::optional<uint8_t> readByte(uint8_t Addr) override;
   bool writeByte(uint8_t Addr, uint8_t Cmd) override;
   std::optional<uint8_t> readByteData(uint8_t Addr, uint8_t Cmd) override;
   bool writeByteData(uint8_t Addr, uint8_t Cmd, uint8_t Val) override;
+  std::optional<uint16_t> readWordData(uint8_t Addr, uint8_t Cmd) override;
   std::vector<uint8_t> readBlockData(uint8_t Addr, uint8_t Cmd) override;
   bool writeBlockData(uint8_t Addr, uint8_t Cmd,
                       const std::vector<uint8_t> Data) override;
+  /// Polls the controller instead of sleeping, so a transaction takes as long
+  /// as it takes on the wire.
+  void step(SMBusRequest &Req) override;
   void print(std::ostream &OS) const override;
 };
 
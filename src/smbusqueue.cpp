@@ -0,0 +1,39 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "smbusqueue.h"
+
+SMBusQueue::Handle SMBusQueue::submit(SMBusRequest Req) {
+  Req.St = SMBusRequest::State::Queued;
+  Handle H = NextHandle++;
+  Pending.emplace_back(H, std::move(Req));
+  return H;
+}
+
+bool SMBusQueue::poll() {
+  while (!Pending.empty()) {
+    auto &[H, Req] = Pending.front();
+    SMB.step(Req);
+    if (!Req.isFinished())
+      return true;
+    Finished.emplace(H, std::move(Req));
+    Pending.pop_front();
+  }
+  return false;
+}
+
+void SMBusQueue::drain() {
+  while (poll())
+    ;
+}
+
+std::optional<SMBusRequest> SMBusQueue::take(Handle H) {
+  auto It = Finished.find(H);
+  if (It == Finished.end())
+    return std::nullopt;
+  SMBusRequest Req = std::move(It->second);
+  Finished.erase(It);
+  return Req;
+}
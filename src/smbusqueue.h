@@ -0,0 +1,47 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// A queue of SMBus transactions, driven by poll() from the caller's own loop
+// instead of blocking until each one is done. The next transaction starts in
+// the same poll() that finishes the previous one, so they run back to back.
+//
+
+#ifndef __SRC_SMBUSQUEUE_H__
+#define __SRC_SMBUSQUEUE_H__
+
+#include "smbus.h"
+#include <deque>
+#include <map>
+#include <optional>
+#include <utility>
+
+class SMBusQueue {
+public:
+  using Handle = unsigned long;
+
+private:
+  SMBus &SMB;
+  Handle NextHandle = 0;
+  /// In submission order, the front one is on the bus.
+  std::deque<std::pair<Handle, SMBusRequest>> Pending;
+  /// The finished ones, until take() collects them.
+  std::map<Handle, SMBusRequest> Finished;
+
+public:
+  SMBusQueue(SMBus &SMB) : SMB(SMB) {}
+  /// Queues \p Req. \Returns the handle for isDone() and take().
+  Handle submit(SMBusRequest Req);
+  /// Advances the transaction on the bus without waiting, starting the next
+  /// one as soon as it finishes. \Returns true while transactions are pending.
+  bool poll();
+  /// Polls until all transactions are finished.
+  void drain();
+  bool isDone(Handle H) const { return Finished.count(H) != 0; }
+  /// \Returns the finished request \p H and forgets it, or nullopt if it is
+  /// still pending. Check SMBusRequest::ok() for the result.
+  std::optional<SMBusRequest> take(Handle H);
+  size_t getNumPending() const { return Pending.size(); }
+};
+
+#endif // __SRC_SMBUSQUEUE_H__
@@ -0,0 +1,301 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "snapshot.h"
+#include "binfile.h"
+#include "log.h"
+#include "session.h"
+#include "utils.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+// The file layout, all little-endian:
+//   u32 Magic, u16 Version, u32 PayloadLen, u32 Checksum, Payload
+// with the payload being:
+//   u32 ID, u32 ClassRev, u32 Subsystem, char PLL[MaxNameLen], u8 PLLAddr,
+//   u8 BlockLen, u8 PLLBlock[BlockLen], u32 NumRegs, NumRegs * (u24 Key, u8 Val)
+static constexpr const unsigned HeaderLen = 14;
+static constexpr const unsigned FixedPayloadLen =
+    3 * 4 + Snapshot::MaxNameLen + 2 + 4;
+static constexpr const unsigned RegLen = 4;
+
+std::optional<Snapshot> Snapshot::capture(Session &S) {
+  Snapshot Snap;
+  // The host bridge is always at 00:00.0.
+  Snap.Fingerprint = HWFingerprint::read(BDF(0, 0, 0));
+  if (S.hasPLL()) {
+    Snap.PLL = S.getPLL().getName();
+    Snap.PLLAddr = S.getPLL().getAddr();
+    Snap.PLLBlock = S.getSMB().readBlockData(Snap.PLLAddr, PLL::Cmd);
+    if (Snap.PLLBlock.empty()) {
+      std::cerr << "Could not read the PLL registers" << '\n';
+      return std::nullopt;
+    }
+    if (Snap.PLLBlock.size() > MaxBlockLen)
+      Snap.PLLBlock.resize(MaxBlockLen);
+  }
+  // The DRAM timings and the registers that -chipset-opt and -pci-tune write.
+  if (S.hasHostBridge()) {
+    HostToPCIBridge &HB = S.getHostBridge();
+    const BDF &Addr = HB.getBDF();
+    for (const DRAMTimingField &Field : HB.getDRAMTimings())
+      Snap.Regs[getKey(Addr, Field.Reg)] = PCI::readByte(Addr, Field.Reg);
+    for (const ChipsetFeature &Feature : HB.getChipsetFeatures())
+      Snap.Regs[getKey(Addr, Feature.Reg)] = PCI::readByte(Addr, Feature.Reg);
+  }
+  PCI::forEachFunction([&Snap](const BDF &Addr) -> bool {
+    // Two dwords cover all three registers.
+    uint32_t Command = PCI::readDword(Addr, PCI::CommandReg);
+    uint32_t Misc = PCI::readDword(Addr, PCI::CacheLineSizeReg);
+    Snap.Regs[getKey(Addr, PCI::CommandReg)] = Command & 0xff;
+    Snap.Regs[getKey(Addr, PCI::CacheLineSizeReg)] = Misc & 0xff;
+    Snap.Regs[getKey(Addr, PCI::LatencyTimerReg)] = (Misc >> 8) & 0xff;
+    return false;
+  });
+  return Snap;
+}
+
+std::optional<Snapshot> Snapshot::load(const std::string &Path) {
+  std::ifstream File(Path, std::ios::binary);
+  if (!File) {
+    std::cerr << "Failed to open " << Path << '\n';
+    return std::nullopt;
+  }
+  std::vector<uint8_t> Bytes((std::istreambuf_iterator<char>(File)),
+                             std::istreambuf_iterator<char>());
+  BinReader R(Bytes);
+  if (Bytes.size() < HeaderLen + FixedPayloadLen || R.get(4) != Magic ||
+      R.get(2) != Version || R.get(4) != Bytes.size() - HeaderLen ||
+      R.get(4) != getBinChecksum(Bytes, HeaderLen)) {
+    std::cerr << Path << ": not a snapshot, corrupt or from another version"
+              << '\n';
+    return std::nullopt;
+  }
+  Snapshot Snap;
+  Snap.Fingerprint.ID = R.get(4);
+  Snap.Fingerprint.ClassRev = R.get(4);
+  Snap.Fingerprint.Subsystem = R.get(4);
+  Snap.PLL = R.getStr(MaxNameLen);
+  Snap.PLLAddr = R.get(1);
+  unsigned BlockLen = R.get(1);
+  if (BlockLen > MaxBlockLen ||
+      Bytes.size() < HeaderLen + FixedPayloadLen + BlockLen) {
+    std::cerr << Path << ": bad PLL block length" << '\n';
+    return std::nullopt;
+  }
+  for (unsigned Idx = 0; Idx != BlockLen; ++Idx)
+    Snap.PLLBlock.push_back(R.get(1));
+  uint32_t NumRegs = R.get(4);
+  if (Bytes.size() - R.getPos() != (size_t)NumRegs * RegLen) {
+    std::cerr << Path << ": bad register count" << '\n';
+    return std::nullopt;
+  }
+  for (uint32_t Idx = 0; Idx != NumRegs; ++Idx) {
+    uint32_t Key = R.get(3);
+    Snap.Regs[Key] = R.get(1);
+  }
+  return Snap;
+}
+
+bool Snapshot::save(const std::string &Path) const {
+  std::vector<uint8_t> Bytes;
+  BinWriter W(Bytes);
+  W.put(Magic, 4);
+  W.put(Version, 2);
+  unsigned BlockLen = std::min<size_t>(PLLBlock.size(), MaxBlockLen);
+  W.put(FixedPayloadLen + BlockLen + Regs.size() * RegLen, 4);
+  // Patched below, once we have the payload.
+  W.put(0, 4);
+  W.put(Fingerprint.ID, 4);
+  W.put(Fingerprint.ClassRev, 4);
+  W.put(Fingerprint.Subsystem, 4);
+  W.putStr(PLL, MaxNameLen);
+  W.put(PLLAddr, 1);
+  W.put(BlockLen, 1);
+  for (unsigned Idx = 0; Idx != BlockLen; ++Idx)
+    W.put(PLLBlock[Idx], 1);
+  W.put(Regs.size(), 4);
+  for (const auto &[Key, Val] : Regs) {
+    W.put(Key, 3);
+    W.put(Val, 1);
+  }
+  W.patch(10, getBinChecksum(Bytes, HeaderLen), 4);
+
+  std::ofstream File(Path, std::ios::binary | std::ios::trunc);
+  File.write((const char *)Bytes.data(), Bytes.size());
+  File.close();
+  if (!File) {
+    std::cerr << "Failed to write " << Path << '\n';
+    return false;
+  }
+  return true;
+}
+
+std::vector<PCIRegChange> Snapshot::diffRegs(const Snapshot &From,
+                                             const Snapshot &To) {
+  std::vector<PCIRegChange> Changes;
+  auto FIt = From.Regs.begin(), FE = From.Regs.end();
+  auto TIt = To.Regs.begin(), TE = To.Regs.end();
+  while (FIt != FE && TIt != TE) {
+    if (FIt->first < TIt->first) {
+      ++FIt;
+    } else if (TIt->first < FIt->first) {
+      ++TIt;
+    } else {
+      if (FIt->second != TIt->second)
+        Changes.push_back({getBDF(FIt->first), (uint8_t)(FIt->first & 0xff),
+                           FIt->second, TIt->second});
+      ++FIt, ++TIt;
+    }
+  }
+  return Changes;
+}
+
+unsigned Snapshot::printDiff(const Snapshot &From, const Snapshot &To,
+                             std::ostream &OS) {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  unsigned NumDiffs = 0;
+  OS << std::hex << std::setfill('0');
+  if (From.Fingerprint != To.Fingerprint) {
+    OS << "Host bridge: " << From.Fingerprint.ID << " -> "
+       << To.Fingerprint.ID << " (different machine or BIOS setup)" << '\n';
+    ++NumDiffs;
+  }
+  if (From.PLL != To.PLL) {
+    OS << "PLL: " << From.PLL << " -> " << To.PLL << '\n';
+    ++NumDiffs;
+  }
+  if (From.PLLAddr != To.PLLAddr) {
+    OS << "PLL address: 0x" << (int)From.PLLAddr << " -> 0x"
+       << (int)To.PLLAddr << '\n';
+    ++NumDiffs;
+  }
+  for (size_t Idx = 0,
+              E = std::max(From.PLLBlock.size(), To.PLLBlock.size());
+       Idx != E; ++Idx) {
+    bool InFrom = Idx < From.PLLBlock.size();
+    bool InTo = Idx < To.PLLBlock.size();
+    if (InFrom && InTo && From.PLLBlock[Idx] == To.PLLBlock[Idx])
+      continue;
+    OS << "PLL byte " << std::dec << Idx << std::hex << ": ";
+    if (InFrom)
+      OS << "0x" << std::setw(2) << (int)From.PLLBlock[Idx];
+    else
+      OS << "none";
+    OS << " -> ";
+    if (InTo)
+      OS << "0x" << std::setw(2) << (int)To.PLLBlock[Idx];
+    else
+      OS << "none";
+    if (Idx >= MaxPLLWriteLen)
+      OS << " (read-only)";
+    OS << '\n';
+    ++NumDiffs;
+  }
+  OS << std::setfill(' ');
+  for (const PCIRegChange &C : diffRegs(From, To)) {
+    C.print(OS);
+    OS << '\n';
+    ++NumDiffs;
+  }
+  // Functions that appeared or disappeared, e.g. a card was moved.
+  auto PrintMissing = [&OS, &NumDiffs](const Snapshot &A, const Snapshot &B,
+                                       const char *Where) {
+    for (const auto &[Key, Val] : A.Regs) {
+      if (B.Regs.count(Key))
+        continue;
+      BDF Addr = getBDF(Key);
+      OS << std::hex << std::setfill('0') << std::setw(2) << Addr.Bus << ":"
+         << std::setw(2) << Addr.Dev << "." << Addr.Fun << " reg 0x"
+         << std::setw(2) << (Key & 0xff) << ": 0x" << std::setw(2) << (int)Val
+         << std::setfill(' ') << " only in the " << Where << " snapshot"
+         << '\n';
+      ++NumDiffs;
+    }
+  };
+  PrintMissing(From, To, "first");
+  PrintMissing(To, From, "second");
+  OS.flags(SvFlags);
+  return NumDiffs;
+}
+
+bool Snapshot::restore(Session &S) const {
+  // Talk to the PLL where the snapshot found it.
+  if (!PLL.empty() && S.hasPLL())
+    S.getPLL().setAddr(PLLAddr);
+  std::optional<Snapshot> Current = capture(S);
+  if (!Current)
+    return false;
+  if (Current->Fingerprint != Fingerprint) {
+    std::cerr << "The snapshot is from a different machine or BIOS setup"
+              << '\n';
+    return false;
+  }
+  if (!PLL.empty() && toLower(Current->PLL) != toLower(PLL)) {
+    std::cerr << "The snapshot is for PLL " << PLL << ", not "
+              << Current->PLL << '\n';
+    return false;
+  }
+  bool Success = true;
+  unsigned NumWrites = 0;
+  // The PLL first, so that the clocks are back before the timings and
+  // features that were tuned for them.
+  size_t End = 0;
+  for (size_t Idx = 0, E = std::min({PLLBlock.size(), Current->PLLBlock.size(),
+                                     (size_t)MaxPLLWriteLen});
+       Idx != E; ++Idx)
+    if (PLLBlock[Idx] != Current->PLLBlock[Idx])
+      End = Idx + 1;
+  if (End != 0) {
+    // A block write always starts at byte 0, so this also rewrites the
+    // unchanged bytes before the last changed one.
+    std::vector<uint8_t> Data(PLLBlock.begin(), PLLBlock.begin() + End);
+    {
+      DecimalGuard DG(std::cout);
+      std::cout << "PLL bytes 0-" << End - 1 << '\n';
+    }
+    SMBus &SMB = S.getSMB();
+    if (!SMB.writeBlockData(PLLAddr, PLL::Cmd, Data)) {
+      std::cerr << "Failed to write block data to PLL" << '\n';
+      return false;
+    }
+    ++NumWrites;
+    std::vector<uint8_t> ReadBack = SMB.readBlockData(PLLAddr, PLL::Cmd);
+    if (ReadBack.size() < End ||
+        !std::equal(Data.begin(), Data.end(), ReadBack.begin())) {
+      std::cerr << "The PLL registers did not read back as written" << '\n';
+      Success = false;
+    }
+  }
+  for (const PCIRegChange &C : diffRegs(*Current, *this)) {
+    C.print(std::cout);
+    std::cout << '\n';
+    PCI::writeByte(C.Addr, C.Reg, C.NewVal);
+    ++NumWrites;
+    uint8_t ReadBack = PCI::readByte(C.Addr, C.Reg);
+    if (ReadBack != C.NewVal) {
+      std::cerr << "  reads back 0x" << Hex(ReadBack) << '\n';
+      Success = false;
+    }
+  }
+  DecimalGuard DG(std::cout);
+  std::cout << "Restored with " << NumWrites << " write(s)" << '\n';
+  return Success;
+}
+
+void Snapshot::print(std::ostream &OS) const {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::hex << "Snapshot: host bridge (" << Fingerprint.ID << " "
+     << Fingerprint.ClassRev << " " << Fingerprint.Subsystem << ")";
+  if (!PLL.empty()) {
+    OS << " PLL " << PLL << " at 0x" << (int)PLLAddr;
+    for (uint8_t Byte : PLLBlock)
+      OS << " " << std::setw(2) << std::setfill('0') << (int)Byte;
+    OS << std::setfill(' ');
+  }
+  OS << std::dec << ", " << Regs.size() << " register(s)";
+  OS.flags(SvFlags);
+}
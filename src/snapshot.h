@@ -0,0 +1,81 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// A snapshot of the hardware state that we change: the PLL register block,
+// the DRAM timing and chipset feature registers of the host bridge, and the
+// command, cache line size and latency timer of every PCI function. Restoring
+// one writes only the registers that differ from the current state, so going
+// back to a known-good state takes one discovery and a few writes.
+//
+
+#ifndef __SRC_SNAPSHOT_H__
+#define __SRC_SNAPSHOT_H__
+
+#include "cache.h"
+#include "pci.h"
+#include "pcitune.h"
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+class Session;
+
+class Snapshot {
+public:
+  /// "SFSN" when read as little-endian.
+  static constexpr const uint32_t Magic = 0x4e534653;
+  /// Bump this whenever the layout changes.
+  static constexpr const uint16_t Version = 2;
+  static constexpr const unsigned MaxNameLen = 16;
+  static constexpr const unsigned MaxBlockLen = 32;
+  /// A block write can only reach the first bytes of the PLL block, the rest
+  /// are usually read-only status bytes anyway.
+  static constexpr const unsigned MaxPLLWriteLen = 8;
+
+  /// The host bridge fingerprint, so that we never restore another machine.
+  HWFingerprint Fingerprint;
+  /// The name of the PLL, empty if the snapshot has no PLL block.
+  std::string PLL;
+  /// The SMBus address the PLL block was read from.
+  uint8_t PLLAddr = 0;
+  std::vector<uint8_t> PLLBlock;
+  /// The configuration registers by getKey(). Sorted, so a diff is a merge.
+  std::map<uint32_t, uint8_t> Regs;
+
+  /// \Returns the 24-bit key of register \p Reg of \p Addr.
+  static uint32_t getKey(const BDF &Addr, uint8_t Reg) {
+    return (uint32_t)Addr.Bus << 16 | Addr.Dev << 11 | Addr.Fun << 8 | Reg;
+  }
+  static BDF getBDF(uint32_t Key) {
+    return BDF(Key >> 16, (Key >> 11) & 0x1f, (Key >> 8) & 0x07);
+  }
+
+  /// Reads the current state. Includes the PLL block if \p S has a PLL and
+  /// the host bridge registers if it has a host bridge. \Returns nullopt if
+  /// the PLL does not respond.
+  static std::optional<Snapshot> capture(Session &S);
+  /// Loads a snapshot from \p Path. \Returns nullopt and prints why if the
+  /// file is missing, corrupt or from a different version.
+  static std::optional<Snapshot> load(const std::string &Path);
+  /// Writes the snapshot to \p Path. \Returns false on error.
+  bool save(const std::string &Path) const;
+
+  /// \Returns the registers whose value differs, from \p From to \p To.
+  static std::vector<PCIRegChange> diffRegs(const Snapshot &From,
+                                            const Snapshot &To);
+  /// Prints everything that differs between \p From and \p To to \p OS.
+  /// \Returns the number of differences.
+  static unsigned printDiff(const Snapshot &From, const Snapshot &To,
+                            std::ostream &OS);
+  /// Captures the current state of \p S and writes the PLL bytes and the
+  /// registers that differ from this snapshot, the PLL first. \Returns false
+  /// on error, or if a register did not read back as written.
+  bool restore(Session &S) const;
+  void print(std::ostream &OS) const;
+};
+
+#endif // __SRC_SNAPSHOT_H__
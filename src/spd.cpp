@@ -0,0 +1,190 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "spd.h"
+#include "utils.h"
+#include <algorithm>
+#include <iomanip>
+
+float SPD::decodeTCK(uint8_t Byte) {
+  // High nibble: ns, low nibble: tenths of ns. JEDEC later added A-D for
+  // 0.25, 0.33, 0.66 and 0.75 ns.
+  static constexpr const float Fractions[] = {0.0,  0.1,  0.2, 0.3,
+                                              0.4,  0.5,  0.6, 0.7,
+                                              0.8,  0.9,  0.25, 0.33,
+                                              0.66, 0.75, 0.0, 0.0};
+  return (Byte >> 4) + Fractions[Byte & 0x0f];
+}
+
+std::optional<uint8_t> SPD::getByte(unsigned Offset) {
+  if (Offset >= MaxSize)
+    return std::nullopt;
+  if (!Cached[Offset]) {
+    // Read the whole word, we will most likely need the neighbour too.
+    unsigned WordOffset = Offset & ~1u;
+    auto WordOpt = SMB.readWordData(Addr, WordOffset);
+    if (!WordOpt) {
+      std::cerr << "Failed to read SPD 0x" << std::hex << (int)Addr
+                << " offset 0x" << Offset << std::dec << std::endl;
+      return std::nullopt;
+    }
+    Image[WordOffset] = *WordOpt & 0xff;
+    Image[WordOffset + 1] = *WordOpt >> 8;
+    Cached[WordOffset] = true;
+    Cached[WordOffset + 1] = true;
+  }
+  return Image[Offset];
+}
+
+unsigned SPD::getSize() {
+  auto BytesUsed = getByte(BytesUsedReg);
+  if (!BytesUsed)
+    return 0;
+  // Most modules report 128, some report 0 or 255 which we treat as 256.
+  if (*BytesUsed == 0 || *BytesUsed == 0xff)
+    return MaxSize;
+  return std::max<unsigned>(*BytesUsed, 128);
+}
+
+bool SPD::readAll() {
+  unsigned Size = getSize();
+  if (Size == 0)
+    return false;
+  for (unsigned Offset = 0; Offset < Size; ++Offset)
+    if (!getByte(Offset))
+      return false;
+  return true;
+}
+
+bool SPD::isSDRAM() {
+  auto Type = getByte(MemTypeReg);
+  return Type && *Type == SDRAMType;
+}
+
+std::vector<unsigned> SPD::getCASLatencies() {
+  std::vector<unsigned> CLs;
+  auto CLByte = getByte(CASLatenciesReg);
+  if (!CLByte)
+    return CLs;
+  for (unsigned Bit = 0; Bit != 7; ++Bit)
+    if (*CLByte & (1u << Bit))
+      CLs.push_back(Bit + 1);
+  return CLs;
+}
+
+std::vector<std::pair<unsigned, float>> SPD::getTCKPerCAS() {
+  std::vector<std::pair<unsigned, float>> Result;
+  std::vector<unsigned> CLs = getCASLatencies();
+  std::reverse(CLs.begin(), CLs.end());
+  static constexpr const uint8_t TCKRegs[] = {TCKReg, TCK2Reg, TCK3Reg};
+  for (unsigned Idx = 0; Idx != CLs.size() && Idx != std::size(TCKRegs);
+       ++Idx) {
+    auto TCKByte = getByte(TCKRegs[Idx]);
+    if (!TCKByte)
+      break;
+    float TCK = decodeTCK(*TCKByte);
+    if (TCK == 0.0)
+      continue;
+    Result.push_back({CLs[Idx], TCK});
+  }
+  return Result;
+}
+
+std::optional<float> SPD::getMaxMHz() {
+  if (!isSDRAM())
+    return std::nullopt;
+  auto TCKByte = getByte(TCKReg);
+  if (!TCKByte)
+    return std::nullopt;
+  float TCK = decodeTCK(*TCKByte);
+  if (TCK == 0.0)
+    return std::nullopt;
+  return 1000.0 / TCK;
+}
+
+const char *SPD::getSpeedGrade() {
+  auto MaxMHz = getMaxMHz();
+  if (!MaxMHz)
+    return "Unknown";
+  if (*MaxMHz + SdramSlackMHz >= 133.0)
+    return "PC133";
+  if (*MaxMHz + SdramSlackMHz >= 100.0)
+    return "PC100";
+  if (*MaxMHz + SdramSlackMHz >= 66.0)
+    return "PC66";
+  return "Unknown";
+}
+
+void SPD::print(std::ostream &OS) {
+  DecimalGuard DG(OS);
+  OS << "DIMM SPD at 0x" << std::hex << (int)Addr << std::dec << ": ";
+  if (!isSDRAM()) {
+    auto Type = getByte(MemTypeReg);
+    OS << "not SDR SDRAM (type " << (Type ? (int)*Type : -1) << ")"
+       << std::endl;
+    return;
+  }
+  OS << getSpeedGrade();
+  if (auto MaxMHz = getMaxMHz())
+    OS << std::fixed << std::setprecision(1) << " max " << *MaxMHz << "MHz";
+  OS << std::endl;
+  for (auto [CL, TCK] : getTCKPerCAS())
+    OS << "  CL" << CL << ": tCK " << std::setprecision(2) << TCK << "ns ("
+       << std::setprecision(1) << 1000.0 / TCK << "MHz)" << std::endl;
+  if (auto IntelFreq = getByte(IntelFreqReg))
+    OS << "  Intel spec frequency: " << (int)*IntelFreq << "MHz" << std::endl;
+}
+
+void SPD::dump(std::ostream &OS) {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::hex << std::setfill('0');
+  for (unsigned Offset = 0, E = getSize(); Offset != E; ++Offset) {
+    if (Offset % 16 == 0)
+      OS << std::setw(2) << Offset << ":";
+    auto Byte = getByte(Offset);
+    OS << " " << std::setw(2) << (Byte ? (int)*Byte : 0);
+    if (Offset % 16 == 15)
+      OS << std::endl;
+  }
+  OS << std::setfill(' ');
+  OS.flags(SvFlags);
+}
+
+std::vector<SPD> SPD::findAll(SMBus &SMB) {
+  std::vector<SPD> SPDs;
+  for (unsigned Addr = FirstAddr; Addr <= LastAddr; ++Addr)
+    if (SMB.probe(Addr, /*Read=*/true))
+      SPDs.push_back(SPD(SMB, Addr));
+  return SPDs;
+}
+
+std::optional<float> SPD::getMaxSdramMHz(std::vector<SPD> &SPDs) {
+  std::optional<float> Limit;
+  for (SPD &S : SPDs) {
+    auto MaxMHz = S.getMaxMHz();
+    if (MaxMHz && (!Limit || *MaxMHz < *Limit))
+      Limit = MaxMHz;
+  }
+  return Limit;
+}
+
+bool SPD::checkSdramLimit(SMBus &SMB, float SdramMHz) {
+  std::vector<SPD> SPDs = findAll(SMB);
+  std::optional<float> Limit = getMaxSdramMHz(SPDs);
+  if (!Limit) {
+    std::cout << "No SPD SDRAM limit found, skipping check" << '\n';
+    return true;
+  }
+  DecimalGuard DG(std::cout);
+  std::cout << "SPD SDRAM limit: " << *Limit << "MHz" << '\n';
+  if (SdramMHz > *Limit + SdramSlackMHz) {
+    DecimalGuard DG(std::cerr);
+    std::cerr << "SDRAM " << SdramMHz
+              << "MHz is above what the DIMMs are rated for (" << *Limit
+              << "MHz). Use -no-spd-check to override." << '\n';
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,96 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Serial Presence Detect (SPD) EEPROMs of SDR SDRAM DIMMs. The layout follows
+// the JEDEC SPD specification for SDRAM (memory type 0x04) along with the
+// Intel PC SDRAM extensions in bytes 126-127.
+//
+
+#ifndef __SRC_SPD_H__
+#define __SRC_SPD_H__
+
+#include "smbus.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+class SPD {
+public:
+  /// The DIMM EEPROMs live at 0x50-0x57, one per slot.
+  static constexpr const uint8_t FirstAddr = 0x50;
+  static constexpr const uint8_t LastAddr = 0x57;
+  /// The largest EEPROM we care about.
+  static constexpr const unsigned MaxSize = 256;
+
+  /// SPD byte offsets.
+  static constexpr const uint8_t BytesUsedReg = 0;
+  static constexpr const uint8_t TotalBytesReg = 1;
+  static constexpr const uint8_t MemTypeReg = 2;
+  /// tCK at the highest CAS latency.
+  static constexpr const uint8_t TCKReg = 9;
+  /// Bitmap of supported CAS latencies, bit 0 for CL1.
+  static constexpr const uint8_t CASLatenciesReg = 18;
+  /// tCK at the second highest CAS latency.
+  static constexpr const uint8_t TCK2Reg = 23;
+  /// tCK at the third highest CAS latency.
+  static constexpr const uint8_t TCK3Reg = 25;
+  /// Intel: frequency the module was specified for (0x64 for PC100).
+  static constexpr const uint8_t IntelFreqReg = 126;
+
+  static constexpr const uint8_t SDRAMType = 0x04;
+
+  /// Allowed difference between the SDRAM clock and the rated one, since the
+  /// PLLs run slightly above the nominal frequency (e.g. 100.2 or 133.6).
+  static constexpr const float SdramSlackMHz = 1.0;
+
+private:
+  SMBus &SMB;
+  uint8_t Addr;
+  /// The EEPROM contents, filled in on demand.
+  std::array<uint8_t, MaxSize> Image;
+  /// Marks the bytes of `Image` that we have already read.
+  std::bitset<MaxSize> Cached;
+
+  /// Decodes the tCK byte into nanoseconds, or 0 if not specified.
+  static float decodeTCK(uint8_t Byte);
+
+public:
+  SPD(SMBus &SMB, uint8_t Addr) : SMB(SMB), Addr(Addr) {}
+  uint8_t getAddr() const { return Addr; }
+  /// \Returns the SPD byte at \p Offset, reading it (and its neighbour) from
+  /// the EEPROM if not cached.
+  std::optional<uint8_t> getByte(unsigned Offset);
+  /// Reads the whole image. \Returns false on error.
+  bool readAll();
+  /// \Returns the number of bytes in the image according to the SPD itself.
+  unsigned getSize();
+  /// \Returns true if this is an SDR SDRAM module.
+  bool isSDRAM();
+  /// \Returns the supported CAS latencies, lowest first.
+  std::vector<unsigned> getCASLatencies();
+  /// \Returns the minimum clock period in ns for each supported CAS latency,
+  /// highest CAS latency first.
+  std::vector<std::pair<unsigned, float>> getTCKPerCAS();
+  /// \Returns the highest SDRAM clock the module is rated for, in MHz.
+  std::optional<float> getMaxMHz();
+  /// \Returns the PC66/PC100/PC133 speed grade.
+  const char *getSpeedGrade();
+  void print(std::ostream &OS);
+  void dump(std::ostream &OS);
+
+  /// \Returns the SPD EEPROMs that respond on \p SMB.
+  static std::vector<SPD> findAll(SMBus &SMB);
+  /// \Returns the SDRAM clock limit of the slowest module in \p SPDs, or
+  /// nullopt if none could be decoded.
+  static std::optional<float> getMaxSdramMHz(std::vector<SPD> &SPDs);
+  /// Reads the SPD EEPROMs on \p SMB and checks \p SdramMHz against their
+  /// limit. \Returns false and prints why if it is above, true if it is not
+  /// or if there is no SPD data.
+  static bool checkSdramLimit(SMBus &SMB, float SdramMHz);
+};
+
+#endif // __SRC_SPD_H__
@@ -0,0 +1,293 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "stress.h"
+#include "cpu.h"
+#include "utils.h"
+#include <cmath>
+#include <iostream>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define STRESS_X86
+#include <mmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+#ifdef LINUX
+#include <atomic>
+#include <chrono>
+#include <thread>
+#else
+#include <csetjmp>
+#include <csignal>
+#endif
+
+// The kernels only use operations with exact results (integer and SIMD
+// integer ops, and IEEE add, mul, div and sqrt with a fixed precision and
+// rounding), so their checksums are the same on every working x86.
+// Changing a kernel means regenerating its Expected checksums.
+
+static constexpr const unsigned NumWords = 256;
+static constexpr const unsigned NumPasses = 32;
+
+static inline uint32_t xorshift(uint32_t &State) {
+  State ^= State << 13;
+  State ^= State >> 17;
+  State ^= State << 5;
+  return State;
+}
+
+static inline uint32_t getState(uint32_t Seed) {
+  return Seed * 0x9e3779b9 + 1;
+}
+
+static inline uint32_t fold(uint32_t Sum, uint32_t Word) {
+  return (Sum << 1 | Sum >> 31) ^ Word;
+}
+
+/// Multiply, divide, rotate and add over 4KB.
+static uint32_t runInteger(uint32_t Seed) {
+  uint32_t A[NumWords * 4];
+  uint32_t State = getState(Seed);
+  for (uint32_t &W : A)
+    W = xorshift(State);
+  const unsigned N = NumWords * 4;
+  for (unsigned P = 0; P != NumPasses; ++P)
+    for (unsigned Idx = 0; Idx != N; ++Idx) {
+      uint32_t B = A[(Idx * 7 + P) % N];
+      uint32_t V = A[Idx] ^ (B << 5 | B >> 27);
+      V = V * 0x01000193 + Idx;
+      V += V / ((B >> 16) | 1);
+      A[Idx] = V;
+    }
+  uint32_t Sum = 0;
+  for (uint32_t W : A)
+    Sum = fold(Sum, W);
+  return Sum;
+}
+
+#ifdef STRESS_X86
+/// A chaotic map in 80-bit extended precision, so that a single wrong bit
+/// spreads to the whole checksum.
+static uint32_t runX87(uint32_t Seed) {
+  // Round to nearest, 64-bit mantissa, all exceptions masked.
+  uint16_t SvCW;
+  uint16_t CW = 0x037f;
+  asm volatile("fnstcw %0" : "=m"(SvCW));
+  asm volatile("fldcw %0" : : "m"(CW));
+  long double X[NumWords];
+  uint32_t State = getState(Seed);
+  for (long double &V : X)
+    V = ((xorshift(State) >> 8) | 1) / 16777216.0L;
+  for (unsigned P = 0; P != NumPasses; ++P)
+    for (unsigned Idx = 0; Idx != NumWords; ++Idx) {
+      long double A = X[Idx];
+      long double B = X[(Idx * 5 + P) % NumWords];
+      long double C = X[(Idx * 11 + P + 1) % NumWords];
+      long double T1 = 3.99L * A * (1.0L - A);
+      long double T2 = 2.0L * B * C / (B + C);
+      X[Idx] = (T1 + std::sqrt(T1 * T2)) * 0.5L;
+    }
+  uint32_t Sum = 0;
+  for (long double V : X) {
+    int64_t Bits = (int64_t)(V * 4611686018427387904.0L); // 2^62
+    Sum = fold(Sum, (uint32_t)Bits ^ (uint32_t)(Bits >> 32));
+  }
+  asm volatile("fldcw %0" : : "m"(SvCW));
+  return Sum;
+}
+
+/// 16-bit multiplies, multiply-adds and shifts.
+__attribute__((target("mmx"))) static uint32_t runMMX(uint32_t Seed) {
+  __m64 V[NumWords * 2];
+  uint32_t State = getState(Seed);
+  const unsigned N = NumWords * 2;
+  for (__m64 &W : V) {
+    uint32_t Lo = xorshift(State);
+    W = _mm_set_pi32(xorshift(State), Lo);
+  }
+  for (unsigned P = 0; P != NumPasses; ++P)
+    for (unsigned Idx = 0; Idx != N; ++Idx) {
+      __m64 A = V[Idx];
+      __m64 B = V[(Idx * 3 + P) % N];
+      __m64 M = _mm_mullo_pi16(A, B);
+      __m64 D = _mm_madd_pi16(A, _mm_srli_pi32(B, 7));
+      V[Idx] = _mm_xor_si64(_mm_add_pi16(M, D),
+                            _mm_adds_pu8(_mm_slli_si64(A, 3), B));
+    }
+  uint32_t Sum = 0;
+  for (__m64 W : V) {
+    Sum = fold(Sum, _mm_cvtsi64_si32(W));
+    Sum = fold(Sum, _mm_cvtsi64_si32(_mm_srli_si64(W, 32)));
+  }
+  _mm_empty();
+  return Sum;
+}
+
+/// The x87 map, four lanes at a time in single precision.
+__attribute__((target("sse"))) static uint32_t runSSE(uint32_t Seed) {
+  // Round to nearest, no flush to zero, all exceptions masked.
+  unsigned SvCSR = _mm_getcsr();
+  _mm_setcsr(0x1f80);
+  __m128 V[NumWords];
+  uint32_t State = getState(Seed);
+  for (__m128 &W : V) {
+    float F[4];
+    for (float &Lane : F)
+      Lane = ((xorshift(State) >> 9) | 1) / 8388608.0f;
+    W = _mm_loadu_ps(F);
+  }
+  const __m128 R = _mm_set1_ps(3.99f);
+  const __m128 One = _mm_set1_ps(1.0f);
+  const __m128 Two = _mm_set1_ps(2.0f);
+  const __m128 Half = _mm_set1_ps(0.5f);
+  for (unsigned P = 0; P != NumPasses; ++P)
+    for (unsigned Idx = 0; Idx != NumWords; ++Idx) {
+      __m128 A = V[Idx];
+      __m128 B = V[(Idx * 5 + P) % NumWords];
+      __m128 C = V[(Idx * 11 + P + 1) % NumWords];
+      // Rotate the lanes so that they mix.
+      B = _mm_shuffle_ps(B, B, _MM_SHUFFLE(0, 3, 2, 1));
+      __m128 T1 = _mm_mul_ps(R, _mm_mul_ps(A, _mm_sub_ps(One, A)));
+      __m128 T2 = _mm_div_ps(_mm_mul_ps(Two, _mm_mul_ps(B, C)),
+                             _mm_add_ps(B, C));
+      __m128 T3 = _mm_sqrt_ps(_mm_mul_ps(T1, T2));
+      V[Idx] = _mm_mul_ps(Half, _mm_add_ps(T1, T3));
+    }
+  uint32_t Sum = 0;
+  for (__m128 W : V) {
+    uint32_t Lanes[4];
+    _mm_storeu_ps((float *)Lanes, W);
+    for (uint32_t Lane : Lanes)
+      Sum = fold(Sum, Lane);
+  }
+  _mm_setcsr(SvCSR);
+  return Sum;
+}
+#endif // STRESS_X86
+
+const CPUStress::Kernel CPUStress::Kernels[] = {
+    {"integer",
+     runInteger,
+     0,
+     {0x9997b900, 0xda5e2001, 0x4a4238f6, 0x42cb915a}},
+#ifdef STRESS_X86
+    {"x87",
+     runX87,
+     CPU::FPUMask,
+     {0x0e118a55, 0x289901f2, 0xa7e2cb85, 0x7f949ca1}},
+    {"mmx",
+     runMMX,
+     CPU::MMXMask,
+     {0xae796ced, 0xc21a9e7a, 0x45ff0549, 0x56a4d1b8}},
+    {"sse",
+     runSSE,
+     CPU::SSEMask,
+     {0x02df9a09, 0x9cf42de6, 0x3a20c9fe, 0x72fb672e}},
+#endif
+};
+
+#ifndef LINUX
+static jmp_buf ProbeJmp;
+static void onSIGILL(int) { longjmp(ProbeJmp, 1); }
+#endif
+
+bool CPUStress::osSupportsSSE() {
+#ifdef LINUX
+  return true;
+#else
+  // Under DOS it is up to the DPMI host, so try one and catch the #UD.
+  auto SvHandler = std::signal(SIGILL, onSIGILL);
+  volatile bool Supported = false;
+  if (setjmp(ProbeJmp) == 0) {
+    asm volatile("xorps %xmm0, %xmm0");
+    Supported = true;
+  }
+  std::signal(SIGILL, SvHandler);
+  return Supported;
+#endif
+}
+
+std::vector<const CPUStress::Kernel *> CPUStress::getSupported() {
+  std::vector<const Kernel *> Ks;
+  for (const Kernel &K : Kernels) {
+    if (K.FeatureMask != 0 && !CPU::hasFeatures(K.FeatureMask))
+      continue;
+    if ((K.FeatureMask & CPU::SSEMask) != 0 && !osSupportsSSE())
+      continue;
+    Ks.push_back(&K);
+  }
+  return Ks;
+}
+
+std::optional<CPUStress::Mismatch>
+CPUStress::stress(const std::vector<const Kernel *> &Ks, unsigned Thread,
+                  const std::function<bool()> &Stop,
+                  unsigned long &Iterations) {
+  for (unsigned long Iter = 0; !Stop(); ++Iter) {
+    uint32_t Seed = Iter % NumSeeds;
+    for (const Kernel *K : Ks) {
+      uint32_t Got = K->Run(Seed);
+      if (Got != K->Expected[Seed])
+        return Mismatch{K->Name, Thread, Iter, Got, K->Expected[Seed]};
+    }
+    ++Iterations;
+  }
+  return std::nullopt;
+}
+
+bool CPUStress::run(unsigned Seconds) {
+  std::vector<const Kernel *> Ks = getSupported();
+  DecimalGuard DG(std::cout);
+  std::cout << "Stress kernels:";
+  for (const Kernel *K : Ks)
+    std::cout << " " << K->Name;
+  std::cout << '\n';
+
+  std::vector<std::optional<Mismatch>> Results;
+  unsigned long Iterations = 0;
+#ifdef LINUX
+  unsigned NumThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "Threads: " << NumThreads << std::endl;
+  Results.resize(NumThreads);
+  std::vector<unsigned long> ThreadIterations(NumThreads, 0);
+  std::atomic<bool> StopFlag(false);
+  auto Stop = [&StopFlag]() { return StopFlag.load(); };
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T != NumThreads; ++T)
+    Threads.emplace_back([&, T]() {
+      Results[T] = stress(Ks, T, Stop, ThreadIterations[T]);
+      // Stop the others too, we have our answer.
+      if (Results[T])
+        StopFlag = true;
+    });
+  unsigned long EndMillis = getMillis() + Seconds * 1000ul;
+  while (!StopFlag && getMillis() < EndMillis)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  StopFlag = true;
+  for (std::thread &Th : Threads)
+    Th.join();
+  for (unsigned long Iters : ThreadIterations)
+    Iterations += Iters;
+#else
+  std::cout << "Threads: 1" << std::endl;
+  unsigned long EndMillis = getMillis() + Seconds * 1000ul;
+  Results.push_back(stress(
+      Ks, 0, [EndMillis]() { return getMillis() >= EndMillis; }, Iterations));
+#endif
+
+  bool Success = true;
+  for (const std::optional<Mismatch> &M : Results) {
+    if (!M)
+      continue;
+    Success = false;
+    std::cerr << "Mismatch in thread " << std::dec << M->Thread << " kernel "
+              << M->KernelName << " iteration " << M->Iteration << ": got 0x"
+              << std::hex << M->Got << " expected 0x" << M->Expected << '\n';
+  }
+  std::cout << Iterations << " iteration(s), "
+            << (Success ? "passed" : "FAILED") << std::endl;
+  return Success;
+}
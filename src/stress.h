@@ -0,0 +1,62 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// CPU stress kernels for -stress-cpu. Each kernel does a fixed amount of
+// deterministic integer, x87, MMX or SSE work and returns a checksum, which
+// must match the one precomputed for its seed. An overclocked core that
+// miscalculates shows up as a mismatch within seconds.
+//
+
+#ifndef __SRC_STRESS_H__
+#define __SRC_STRESS_H__
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+class CPUStress {
+public:
+  /// The kernels cycle through this many seeds.
+  static constexpr const unsigned NumSeeds = 4;
+
+  struct Kernel {
+    const char *Name;
+    /// \Returns the checksum of the work for \p Seed.
+    uint32_t (*Run)(uint32_t Seed);
+    /// The CPUID leaf 1 EDX bits the kernel needs, 0 for none.
+    uint32_t FeatureMask;
+    uint32_t Expected[NumSeeds];
+  };
+
+  struct Mismatch {
+    const char *KernelName;
+    unsigned Thread;
+    /// The iteration of the thread, starting from 0.
+    unsigned long Iteration;
+    uint32_t Got;
+    uint32_t Expected;
+  };
+
+private:
+  static const Kernel Kernels[];
+
+  /// \Returns false if the OS did not enable SSE (CR4.OSFXSR), so that SSE
+  /// instructions fault even though CPUID reports them.
+  static bool osSupportsSSE();
+  /// Runs all of \p Ks until \p Stop returns true or a checksum mismatches.
+  /// Adds the iterations done to \p Iterations.
+  static std::optional<Mismatch>
+  stress(const std::vector<const Kernel *> &Ks, unsigned Thread,
+         const std::function<bool()> &Stop, unsigned long &Iterations);
+
+public:
+  /// \Returns the kernels this CPU can run.
+  static std::vector<const Kernel *> getSupported();
+  /// Runs the supported kernels for \p Seconds, one thread per CPU on Linux.
+  /// \Returns false and prints the first mismatch of each thread if any.
+  static bool run(unsigned Seconds);
+};
+
+#endif // __SRC_STRESS_H__
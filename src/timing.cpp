@@ -0,0 +1,81 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+
+#include "timing.h"
+#include "clock.h"
+#include "pci.h"
+#include "smbus.h"
+#include "utils.h"
+#include <cstdlib>
+#include <iomanip>
+
+bool Timing::Enabled = false;
+unsigned Timing::Depth = 0;
+std::vector<Timing::Phase> Timing::Phases;
+
+void Timing::enable() {
+  if (Enabled)
+    return;
+  Enabled = true;
+  // Most error paths exit(), so this is the only place that sees them all.
+  std::atexit([]() { report(std::cout); });
+}
+
+void Timing::report(std::ostream &OS) {
+  std::ostream::fmtflags SvFlags = OS.flags();
+  OS << std::dec << "\nClock source: " << ClockSource::get().getName();
+  OS << "\nPhase                      ms    SMBus      PCI\n";
+  for (Phase &P : Phases) {
+    // Count the phases cut short by exit() up to now.
+    if (!P.Done)
+      P.finish();
+    OS << std::string(P.Depth * 2, ' ') << std::left
+       << std::setw(20 - P.Depth * 2) << P.Name << std::right << std::fixed
+       << std::setprecision(1) << std::setw(10) << P.Micros / 1000.0
+       << std::setw(9) << P.SMBusTransactions << std::setw(9) << P.PCIAccesses
+       << (P.Done ? "\n" : " (exit)\n");
+  }
+  unsigned long NumRecoveries = SiSSMBus::FailedRecoveries;
+  for (unsigned long Cnt : SiSSMBus::Recoveries)
+    NumRecoveries += Cnt;
+  if (NumRecoveries != 0) {
+    OS << "SMBus recoveries:";
+    for (unsigned R = 0; R != (unsigned)SiSSMBus::Remedy::NumRemedies; ++R)
+      OS << " " << SiSSMBus::getName((SiSSMBus::Remedy)R) << " "
+         << SiSSMBus::Recoveries[R];
+    OS << " failed " << SiSSMBus::FailedRecoveries << '\n';
+  }
+  OS << "TIMING";
+  for (const Phase &P : Phases)
+    if (P.Depth == 0)
+      OS << " " << P.Name << ":us=" << P.Micros
+         << ",smb=" << P.SMBusTransactions << ",pci=" << P.PCIAccesses;
+  OS << std::endl;
+  OS.flags(SvFlags);
+}
+
+void Timing::Phase::finish() {
+  Micros = getMicros() - StartMicros;
+  SMBusTransactions = SMBus::Transactions - StartSMBus;
+  PCIAccesses = PCI::ConfigAccesses - StartPCI;
+}
+
+void PhaseTimer::start(const char *Name) {
+  if (!Timing::Enabled)
+    return;
+  Idx = Timing::Phases.size();
+  Timing::Phases.push_back({Name, Timing::Depth++, getMicros(),
+                            SMBus::Transactions, PCI::ConfigAccesses});
+}
+
+void PhaseTimer::stop() {
+  if (Idx < 0)
+    return;
+  Timing::Phase &P = Timing::Phases[Idx];
+  P.finish();
+  P.Done = true;
+  --Timing::Depth;
+  Idx = -1;
+}
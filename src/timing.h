@@ -0,0 +1,66 @@
+//-*- C++ -*-
+//
+// Copyright (C) 2025 Scrap Computing
+//
+// Per-phase wall time and I/O counters, printed with -timing.
+//
+
+#ifndef __SRC_TIMING_H__
+#define __SRC_TIMING_H__
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+class Timing {
+public:
+  struct Phase {
+    const char *Name;
+    /// The nesting depth, 0 for the top-level phases.
+    unsigned Depth;
+    uint64_t StartMicros;
+    unsigned long StartSMBus;
+    unsigned long StartPCI;
+    uint64_t Micros = 0;
+    unsigned long SMBusTransactions = 0;
+    unsigned long PCIAccesses = 0;
+    /// False if we exit()ed before the end of the phase.
+    bool Done = false;
+    /// Fills in the totals up to now.
+    void finish();
+  };
+
+private:
+  static bool Enabled;
+  static unsigned Depth;
+  static std::vector<Phase> Phases;
+  friend class PhaseTimer;
+
+public:
+  /// Starts collecting and prints the report at exit.
+  static void enable();
+  static bool isEnabled() { return Enabled; }
+  /// Prints a table of all phases, followed by a single "TIMING" line with
+  /// the top-level phases as name:us=..,smb=..,pci=.. for scripts.
+  static void report(std::ostream &OS);
+};
+
+/// Times the enclosing scope as a phase. Phases nest.
+class PhaseTimer {
+  /// The index in Timing::Phases, or -1 if not running.
+  int Idx = -1;
+
+  void start(const char *Name);
+
+public:
+  PhaseTimer(const char *Name) { start(Name); }
+  ~PhaseTimer() { stop(); }
+  /// Ends the current phase and starts \p Name at the same depth.
+  void next(const char *Name) {
+    stop();
+    start(Name);
+  }
+  void stop();
+};
+
+#endif // __SRC_TIMING_H__
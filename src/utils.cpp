@@ -1,16 +1,21 @@
 
 #include "utils.h"
+#include "clock.h"
 #include <algorithm>
-#include <chrono>
 
-void delay(unsigned Millis) {
-  auto Start = std::chrono::high_resolution_clock::now();
-  while (true) {
-    auto Now = std::chrono::high_resolution_clock::now();
-    double Elapsed = std::chrono::duration<double, std::milli>(Now - Start).count();
-    if (Elapsed > Millis)
-      break;
-  }
+void delay(unsigned Millis) { delayMicros(Millis * 1000u); }
+
+void delayMicros(unsigned Micros) {
+  uint64_t Start = getMicros();
+  while (getMicros() - Start < Micros)
+    ;
+}
+
+unsigned long getMillis() { return getMicros() / 1000; }
+
+uint64_t getMicros() {
+  static uint64_t Start = ClockSource::get().getMicros();
+  return ClockSource::get().getMicros() - Start;
 }
 
 std::string toLower(const std::string &Str) {
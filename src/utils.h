@@ -6,6 +6,7 @@
 #ifndef __SRC_UTILS_H__
 #define __SRC_UTILS_H__
 
+#include "log.h"
 #include <ostream>
 #include <string>
 
@@ -26,15 +27,21 @@ static inline uint32_t inportl(uint16_t Reg) { return 0; }
 
 #endif // LINUX
 
-/// Sleep for \p Millis milliseconds with a busy loop.
+/// Sleep for \p Millis milliseconds with a busy loop on ClockSource.
 void delay(unsigned Millis);
 
+/// Sleep for \p Micros microseconds with a busy loop.
+void delayMicros(unsigned Micros);
+
+/// \Returns the milliseconds elapsed since the first call.
+unsigned long getMillis();
+
+/// \Returns the microseconds elapsed since the first call, from ClockSource.
+uint64_t getMicros();
+
 /// Converts \p Str to lower case and returns it.
 std::string toLower(const std::string &Str);
 
-/// Whether we should print debug info.
-extern bool Debug;
-
 class DecimalGuard {
   std::ostream &OS;
   std::ostream::fmtflags SvFlags;